@@ -0,0 +1,338 @@
+/*
+ * bench.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+
+#include "cache.h"
+#include "bench.h"
+
+/************************************************************/
+// modo --bench: genera en memoria trazas sintéticas grandes y
+// deterministas y mide cuánto tarda cada configuración en
+// simularlas. Sirve para comparar el camino de acceso entre
+// versiones del simulador; las trazas de trazas/ son muy chicas
+// para medir algo. Los resultados salen en JSON.
+/************************************************************/
+
+static const char *bench_names[BENCH_GENERATORS] = {
+  "seq", "stride", "random", "zipf", "chase", "loop"
+};
+
+/************************************************************/
+// compilado con -DSIM_BENCH_ALLOCS, cuenta las llamadas a malloc,
+// calloc y realloc de todo el programa para reportar las
+// reservaciones por referencia del camino de acceso (debe ser ~0).
+// Reemplazar malloc le cuesta un incremento atómico a cada
+// reservación del proceso, así que un binario normal no lo hace.
+// Solo con glibc, que deja llamar a su malloc por __libc_malloc;
+// sin la bandera o en otras bibliotecas el JSON dice null
+#if defined(SIM_BENCH_ALLOCS) && defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCS 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static atomic_ulong bench_allocs;
+
+void *malloc(size_t size)
+{
+  atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+  atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+#endif
+/************************************************************/
+
+/************************************************************/
+/* helper function to draw the next number of a splitmix64 sequence */
+static unsigned long long bench_rand(unsigned long long *state)
+{
+  unsigned long long z = (*state += 0x9e3779b97f4a7c15ull);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+/* helper function to read a monotonic clock in seconds */
+static double bench_now()
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* helper function to read the peak resident set size in KB */
+static long bench_peak_rss()
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+// rango de 1 a n con popularidad Zipf de exponente alpha, con la
+// inversa de la distribución continua (sin tablas, así que sirve
+// para cualquier footprint)
+static unsigned zipf_rank(unsigned long long *state, unsigned n, double alpha)
+{
+  double u = (bench_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+  double e = 1.0 - alpha;
+  double x = pow((pow(n, e) - 1.0) * u + 1.0, 1.0 / e);
+
+  return x >= n ? n : (unsigned)x;
+}
+/************************************************************/
+
+/************************************************************/
+// valores default de la traza sintética (ver bench.h)
+void init_bench_config(config)
+  Pbench_config config;
+{
+  config->refs = BENCH_REFS;
+  config->footprint = BENCH_FOOTPRINT;
+  config->inst_pct = BENCH_INST_PCT;
+  config->store_pct = BENCH_STORE_PCT;
+  config->stride = BENCH_STRIDE;
+  config->seed = DEFAULT_SEED;
+  config->generators = (1 << BENCH_GENERATORS) - 1;
+}
+
+// imprime el problema y regresa -1 si la traza no se puede generar
+int check_bench_config(config)
+  Pbench_config config;
+{
+  if (config->refs < 1) {
+    printf("error:  a benchmark trace needs at least one reference\n");
+    return -1;
+  }
+  if (log2_int(config->footprint) < 0 || config->footprint < BENCH_CODE_BYTES) {
+    printf("error:  footprint %u is not a power of two of at least %d bytes\n",
+    config->footprint, BENCH_CODE_BYTES);
+    return -1;
+  }
+  if (config->inst_pct < 0 || config->inst_pct > 100 ||
+      config->store_pct < 0 || config->store_pct > 100) {
+    printf("error:  instruction and store mixes are percentages\n");
+    return -1;
+  }
+  if (config->stride < 1) {
+    printf("error:  stride %d must be at least 1\n", config->stride);
+    return -1;
+  }
+  return 0;
+}
+
+const char *bench_name(generator)
+  int generator;
+{
+  return bench_names[generator];
+}
+
+// generador de un nombre de -tg, -1 si no existe
+int bench_from_name(name)
+  const char *name;
+{
+  int g;
+
+  for (g = 0; g < BENCH_GENERATORS; g++)
+    if (!strcmp(name, bench_names[g]))
+      return g;
+  return -1;
+}
+/************************************************************/
+
+/************************************************************/
+// llena types y addrs con config->refs referencias del generador.
+// Una fracción inst_pct son fetches que recorren un ciclo de
+// BENCH_CODE_BYTES; el resto son datos del patrón del generador,
+// escrituras con probabilidad store_pct. chase solo lee y loop
+// decide sus escrituras: C[i][j] += A[i][k] * B[k][j] lee A y B en
+// cada iteración de k y escribe C al terminarla
+void bench_generate(config, generator, types, addrs)
+  Pbench_config config;
+  int generator;
+  unsigned char *types;
+  sim_addr *addrs;
+{
+  unsigned long long state = config->seed * 0x100000001b3ull + generator;
+  unsigned long long k = 0; // referencias a datos generadas
+  unsigned nodes = config->footprint / BENCH_NODE_BYTES;
+  unsigned pc = 0, offset = 0, cur = 0, *next = NULL, j, t;
+  unsigned dim = 1, li = 0, lj = 0, lk = 0, phase = 0;
+  int n, type;
+
+  if (generator == BENCH_CHASE) {
+    // algoritmo de Sattolo: una permutación de un solo ciclo
+    next = (unsigned *)malloc(sizeof(unsigned) * nodes);
+    for (j = 0; j < nodes; j++)
+      next[j] = j;
+    for (j = nodes - 1; j > 0; j--) {
+      unsigned r = bench_rand(&state) % j;
+      t = next[j];
+      next[j] = next[r];
+      next[r] = t;
+    }
+  }
+  // tres matrices de doubles de dim x dim caben en el footprint
+  while (3 * 8 * (dim + 1) * (dim + 1) <= config->footprint)
+    dim++;
+
+  for (n = 0; n < config->refs; n++) {
+    if (bench_rand(&state) % 100 < (unsigned)config->inst_pct) {
+      types[n] = TRACE_INST_LOAD;
+      addrs[n] = BENCH_CODE_BASE + pc;
+      pc = (pc + WORD_SIZE) % BENCH_CODE_BYTES;
+      continue;
+    }
+    type = bench_rand(&state) % 100 < (unsigned)config->store_pct ? TRACE_DATA_STORE : TRACE_DATA_LOAD;
+
+    switch (generator) {
+    case BENCH_SEQUENTIAL:
+      offset = (k * WORD_SIZE) % config->footprint;
+      break;
+    case BENCH_STRIDED:
+      offset = (k * config->stride) % config->footprint;
+      break;
+    case BENCH_RANDOM:
+      offset = (bench_rand(&state) % (config->footprint / WORD_SIZE)) * WORD_SIZE;
+      break;
+    case BENCH_ZIPF:
+      // los bloques populares se dispersan por el footprint
+      j = ((zipf_rank(&state, nodes, BENCH_ZIPF_ALPHA) - 1) * 2654435761u) & (nodes - 1);
+      offset = j * BENCH_NODE_BYTES + (bench_rand(&state) % (BENCH_NODE_BYTES / WORD_SIZE)) * WORD_SIZE;
+      break;
+    case BENCH_CHASE:
+      offset = cur * BENCH_NODE_BYTES;
+      cur = next[cur];
+      type = TRACE_DATA_LOAD;
+      break;
+    case BENCH_LOOP:
+      if (phase == 0) {
+        offset = (li * dim + lk) * 8;
+        type = TRACE_DATA_LOAD;
+        phase = 1;
+      } else if (phase == 1) {
+        offset = (dim * dim + lk * dim + lj) * 8;
+        type = TRACE_DATA_LOAD;
+        phase = ++lk == dim ? 2 : 0;
+      } else {
+        offset = (2 * dim * dim + li * dim + lj) * 8;
+        type = TRACE_DATA_STORE;
+        phase = lk = 0;
+        if (++lj == dim) {
+          lj = 0;
+          li = (li + 1) % dim;
+        }
+      }
+      break;
+    }
+    types[n] = type;
+    addrs[n] = BENCH_DATA_BASE + offset;
+    k++;
+  }
+  free(next);
+}
+/************************************************************/
+
+/************************************************************/
+// el JSON es un objeto con los parámetros de las trazas y un
+// arreglo results con un elemento por traza y configuración
+void bench_print_header(config)
+  Pbench_config config;
+{
+  printf("{\n");
+  printf("  \"refs\": %d,\n", config->refs);
+  printf("  \"footprint\": %u,\n", config->footprint);
+  printf("  \"inst_pct\": %d,\n", config->inst_pct);
+  printf("  \"store_pct\": %d,\n", config->store_pct);
+  printf("  \"stride\": %d,\n", config->stride);
+  printf("  \"seed\": %u,\n", config->seed);
+  printf("  \"results\": [");
+}
+
+// simula la traza completa con sim, que no debe haber simulado
+// nada, y agrega su elemento a results. El tiempo incluye reservar
+// los caches (en el primer acceso) y el flush final
+void bench_run(config, generator, types, addrs, sim, first)
+  Pbench_config config;
+  int generator;
+  unsigned char *types;
+  sim_addr *addrs;
+  Pcache_sim sim;
+  int first;
+{
+  double start, seconds;
+#if defined(BENCH_COUNT_ALLOCS)
+  unsigned long allocs;
+#endif
+
+#if defined(BENCH_COUNT_ALLOCS)
+  allocs = atomic_load(&bench_allocs);
+#endif
+  start = bench_now();
+  sim_access_batch(sim, types, addrs, config->refs);
+  sim_flush(sim);
+  seconds = bench_now() - start;
+#if defined(BENCH_COUNT_ALLOCS)
+  allocs = atomic_load(&bench_allocs) - allocs;
+#endif
+
+  printf("%s\n    {\"trace\": \"%s\", ", first ? "" : ",", bench_names[generator]);
+  printf("\"config\": {\"usize\": %d, \"isize\": %d, \"dsize\": %d, \"assoc\": %d, \"block\": %d, ",
+         sim->cache_split ? 0 : sim->cache_usize, sim->cache_split ? sim->cache_isize : 0,
+         sim->cache_split ? sim->cache_dsize : 0, sim->cache_assoc, sim->cache_block_size);
+  printf("\"write\": \"%s\", \"alloc\": \"%s\", \"replacement\": \"%s\", ",
+         sim->cache_writeback ? "wb" : "wt", sim->cache_writealloc ? "wa" : "nw",
+         replacement_name(sim->replacement));
+  printf("\"l2\": %d, \"l3\": %d, \"inclusion\": \"%s\", \"prefetcher\": \"%s\", \"victim\": %d, \"classify\": %s, ",
+         sim->lower_size[0], sim->lower_size[0] > 0 ? sim->lower_size[1] : 0,
+         inclusion_name(sim->inclusion), prefetcher_name(sim->prefetch_kind),
+         sim->victim_entries, sim->classify ? "true" : "false");
+  printf("\"write_buffer\": %d, \"wb_drain\": \"%s\", \"wb_rate\": %d}, ",
+         sim->wbuf ? sim->wbuf_entries : 0, drain_name(sim->wbuf_drain), sim->wbuf_rate);
+  printf("\"l1_misses\": %lld, \"l1_traffic_bytes\": %lld, ",
+         sim->cache_stat_inst.misses + sim->cache_stat_data.misses,
+         sim->cache_stat_inst.demand_bytes + sim->cache_stat_data.demand_bytes +
+         sim->cache_stat_inst.copies_back_bytes + sim->cache_stat_data.copies_back_bytes);
+  printf("\"seconds\": %.6f, \"refs_per_sec\": %.0f, \"ns_per_ref\": %.3f, ",
+         seconds,
+         seconds > 0 ? config->refs / seconds : 0.0, seconds * 1e9 / config->refs);
+#if defined(BENCH_COUNT_ALLOCS)
+  printf("\"allocs_per_ref\": %.6g}", (double)allocs / config->refs);
+#else
+  printf("\"allocs_per_ref\": null}");
+#endif
+  fflush(stdout);
+}
+
+// el pico de memoria residente es de todo el proceso, así que se
+// reporta una sola vez, después de todos los resultados
+void bench_print_footer()
+{
+  printf("\n  ],\n");
+  printf("  \"process_peak_rss_kb\": %ld\n}\n", bench_peak_rss());
+}
+/************************************************************/
@@ -0,0 +1,47 @@
+/*
+ * bench.h
+ */
+
+/* generadores de trazas sintéticas de --bench */
+#define BENCH_SEQUENTIAL 0 /* consecutive words */
+#define BENCH_STRIDED 1    /* a fixed stride in bytes */
+#define BENCH_RANDOM 2     /* uniform over the footprint */
+#define BENCH_ZIPF 3       /* Zipfian popularity of the blocks */
+#define BENCH_CHASE 4      /* pointer chase over a random cycle */
+#define BENCH_LOOP 5       /* i, j, k loop nest of a matrix product */
+#define BENCH_GENERATORS 6
+
+/* valores default de la traza sintética */
+#define BENCH_REFS (1 << 22)             /* references per trace */
+#define BENCH_FOOTPRINT (16 << 20)       /* bytes of data touched */
+#define BENCH_INST_PCT 30                /* instruction fetches, in percent */
+#define BENCH_STORE_PCT 25               /* stores among data references */
+#define BENCH_STRIDE 256                 /* bytes, strided generator */
+#define BENCH_ZIPF_ALPHA 0.99
+#define BENCH_CODE_BYTES 4096            /* loop body the fetches walk */
+#define BENCH_DATA_BASE 0x10000000u
+#define BENCH_CODE_BASE 0x00400000u
+#define BENCH_NODE_BYTES 64              /* pointer chase and Zipf item size */
+
+/* structure definitions */
+// parámetros de las trazas sintéticas; todas salen de la misma
+// semilla, así que dos corridas generan exactamente las mismas
+typedef struct bench_config_
+{
+  int refs;           /* references per trace */
+  unsigned footprint; /* power of two, in bytes */
+  int inst_pct;
+  int store_pct;
+  int stride;
+  unsigned seed;
+  int generators;     /* bit g set to run generator g */
+} bench_config, *Pbench_config;
+
+void init_bench_config();
+int check_bench_config();
+const char *bench_name();
+int bench_from_name();
+void bench_generate();
+void bench_print_header();
+void bench_run();
+void bench_print_footer();
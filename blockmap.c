@@ -0,0 +1,86 @@
+/*
+ * blockmap.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+
+/************************************************************/
+// mapa de bloques de direccionamiento abierto, el de la sombra de
+// -3c y el de --stack: cada entrada empieza con su llave (número de
+// bloque + 1, 0 si está vacía) y el resto es de quien lo usa. El
+// mapa se duplica al llegar a la mitad de su capacidad, y solo al
+// agregar un bloque, así que los apuntadores a entradas siguen
+// siendo válidos mientras no se agregue otro.
+/************************************************************/
+
+/* helper function with the key of entry i */
+static sim_addr *entry_key(Pblock_map map, unsigned i)
+{
+  return (sim_addr *)(map->entries + (size_t)i * map->entry_size);
+}
+
+/************************************************************/
+/* gives map size empty entries of entry_size bytes; size must be a
+ * power of two */
+void init_block_map(Pblock_map map, int entry_size, unsigned size)
+{
+  map->entry_size = entry_size;
+  map->map_size = size;
+  map->n_blocks = 0;
+  map->entries = (char *)calloc(size, entry_size);
+}
+
+void free_block_map(Pblock_map map)
+{
+  free(map->entries);
+}
+
+/* helper function to double the map, moving every entry */
+static void block_map_grow(Pblock_map map)
+{
+  char *old = map->entries;
+  unsigned old_size = map->map_size, i, j, mask;
+  sim_addr key;
+
+  map->map_size *= 2;
+  map->entries = (char *)calloc(map->map_size, map->entry_size);
+  mask = map->map_size - 1;
+  for (j = 0; j < old_size; j++) {
+    key = *(sim_addr *)(old + (size_t)j * map->entry_size);
+    if (key == 0)
+      continue;
+    for (i = BLOCK_HASH(key - 1) & mask; *entry_key(map, i); i = (i + 1) & mask)
+      ;
+    memcpy(entry_key(map, i), old + (size_t)j * map->entry_size, map->entry_size);
+  }
+  free(old);
+}
+
+// busca block en el mapa; si no está lo agrega con el resto de la
+// entrada en ceros y pone is_new en TRUE
+void *block_map_find(Pblock_map map, sim_addr block, int *is_new)
+{
+  unsigned i, mask = map->map_size - 1;
+  sim_addr *key;
+
+  *is_new = FALSE;
+  for (i = BLOCK_HASH(block) & mask; *(key = entry_key(map, i)); i = (i + 1) & mask) {
+    if (*key == block + 1)
+      return key;
+  }
+
+  if (2 * (map->n_blocks + 1) > map->map_size) {
+    block_map_grow(map);
+    mask = map->map_size - 1;
+    for (i = BLOCK_HASH(block) & mask; *(key = entry_key(map, i)); i = (i + 1) & mask)
+      ;
+  }
+  *is_new = TRUE;
+  map->n_blocks++;
+  *key = block + 1;
+  return key;
+}
+/************************************************************/
@@ -0,0 +1,21 @@
+/*
+ * blockmap.h
+ */
+
+/* multiplicative hash of a block number (or region) folded into 32
+ * bits; 32-bit addresses stay as they are */
+#define BLOCK_HASH(block) ((unsigned)((block) ^ ((block) >> 32)) * 2654435761u)
+
+// mapa de bloques de direccionamiento abierto (ver blockmap.c);
+// cada entrada empieza con un sim_addr, el número de bloque + 1
+typedef struct block_map_
+{
+  char *entries;      /* map_size entries of entry_size bytes */
+  int entry_size;
+  unsigned map_size;  /* power of two */
+  unsigned n_blocks;  /* entries in use */
+} block_map, *Pblock_map;
+
+void init_block_map();
+void free_block_map();
+void *block_map_find();
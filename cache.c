@@ -5,80 +5,170 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <math.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "cache.h"
+#include "hierarchy.h"
+#include "prefetch.h"
+#include "classify.h"
+#include "victim.h"
+#include "heatmap.h"
+#include "writebuf.h"
 #include "main.h"
 
-/* cache configuration parameters */
-// En esta sección se están declarando variables globales
-// que sirven para simular el cache. Estas se están
-// inizializando a los valores default definidos en
-// cache.h
-static int cache_split = FALSE;
-static int cache_usize = DEFAULT_CACHE_SIZE;
-static int cache_isize = DEFAULT_CACHE_SIZE; 
-static int cache_dsize = DEFAULT_CACHE_SIZE;
-static int cache_block_size = DEFAULT_CACHE_BLOCK_SIZE;
-static int words_per_block = DEFAULT_CACHE_BLOCK_SIZE / WORD_SIZE;
-static int cache_assoc = DEFAULT_CACHE_ASSOC;
-static int cache_writeback = DEFAULT_CACHE_WRITEBACK;
-static int cache_writealloc = DEFAULT_CACHE_WRITEALLOC;
-static int address_size = DEFAULT_ADDRESS_SIZE;
-static int debug = DEFAULT_DEBUG;
-
-/* cache model data structures */
-static Pcache ptr_icache; // apuntador a cache de instrucciones
-static Pcache ptr_dcache; // apuntador a cache de datos
-static cache icache; // cache de instrucciones, o cache unico en caso unificado
-static cache dcache; // cache de datos
-static cache_stat cache_stat_inst; // estadísticas del cache de instrucciones
-static cache_stat cache_stat_data; // estadísticas del cache de datos
+/************************************************************/
+// reserva un simulador nuevo con los parámetros de cache
+// inicializados a los valores default definidos en cache.h.
+// Cada simulador tiene su propia configuración, caches y
+// estadísticas, por lo que se pueden simular varios a la vez.
+// Se alinea a SIM_CACHE_LINE para que sus contadores no compartan
+// línea con los de otro simulador
+Pcache_sim get_new_cache_sim()
+{
+  Pcache_sim sim;
+
+#ifdef _WIN32
+  sim = (Pcache_sim)_aligned_malloc(sizeof(cache_sim), SIM_CACHE_LINE);
+#else
+  if (posix_memalign((void **)&sim, SIM_CACHE_LINE, sizeof(cache_sim)))
+    sim = NULL;
+#endif
+  if (sim == NULL)
+    return NULL;
+  memset(sim, 0, sizeof(cache_sim));
+
+  sim->cache_split = FALSE;
+  sim->cache_usize = DEFAULT_CACHE_SIZE;
+  sim->cache_isize = DEFAULT_CACHE_SIZE;
+  sim->cache_dsize = DEFAULT_CACHE_SIZE;
+  sim->cache_block_size = DEFAULT_CACHE_BLOCK_SIZE;
+  sim->words_per_block = DEFAULT_CACHE_BLOCK_SIZE / WORD_SIZE;
+  sim->cache_assoc = DEFAULT_CACHE_ASSOC;
+  sim->cache_writeback = DEFAULT_CACHE_WRITEBACK;
+  sim->cache_writealloc = DEFAULT_CACHE_WRITEALLOC;
+  sim->address_size = DEFAULT_ADDRESS_SIZE;
+  sim->debug = DEFAULT_DEBUG;
+  sim->replacement = DEFAULT_REPLACEMENT;
+  sim->seed = DEFAULT_SEED;
+  for (int k = 0; k < MAX_LOWER_LEVELS; k++) {
+    sim->lower_size[k] = 0;
+    sim->lower_assoc[k] = DEFAULT_LOWER_ASSOC;
+  }
+  sim->inclusion = DEFAULT_INCLUSION;
+  sim->prefetch_kind = DEFAULT_PREFETCHER;
+  sim->prefetch_degree = DEFAULT_PREFETCH_DEGREE;
+  sim->prefetch_latency = DEFAULT_PREFETCH_LATENCY;
+  sim->classify = DEFAULT_CLASSIFY;
+  sim->victim_entries = DEFAULT_VICTIM_ENTRIES;
+  sim->heatmap = DEFAULT_HEATMAP;
+  sim->wbuf_entries = DEFAULT_WRITE_BUFFER;
+  sim->wbuf_drain = DEFAULT_WB_DRAIN;
+  sim->wbuf_rate = DEFAULT_WB_RATE;
+  return sim;
+}
+/************************************************************/
 
 /************************************************************/
 // esta función es llamada en múltiples ocasiones desde main.c
 // específicamente, se llama por cada argumento válido en la 
-// línea de comandos. Esta función modifica las variables
-// locales declaradas al inicio de este archivo
-void set_cache_param(param, value)
+// línea de comandos. Esta función modifica los parámetros
+// del simulador sim
+void set_cache_param(sim, param, value)
+  Pcache_sim sim;
   int param;
   int value;
 {
 
   switch (param) {
   case CACHE_PARAM_BLOCK_SIZE:
-    cache_block_size = value;
-    words_per_block = value / WORD_SIZE;
+    sim->cache_block_size = value;
+    sim->words_per_block = value / WORD_SIZE;
     break;
   case CACHE_PARAM_USIZE:
-    cache_split = FALSE;
-    cache_usize = value;
+    sim->cache_split = FALSE;
+    sim->cache_usize = value;
     break;
   case CACHE_PARAM_ISIZE:
-    cache_split = TRUE;
-    cache_isize = value;
+    sim->cache_split = TRUE;
+    sim->cache_isize = value;
     break;
   case CACHE_PARAM_DSIZE:
-    cache_split = TRUE;
-    cache_dsize = value;
+    sim->cache_split = TRUE;
+    sim->cache_dsize = value;
     break;
   case CACHE_PARAM_ASSOC:
-    cache_assoc = value;
+    sim->cache_assoc = value;
     break;
   case CACHE_PARAM_WRITEBACK:
-    cache_writeback = TRUE;
+    sim->cache_writeback = TRUE;
     break;
   case CACHE_PARAM_WRITETHROUGH:
-    cache_writeback = FALSE;
+    sim->cache_writeback = FALSE;
     break;
   case CACHE_PARAM_WRITEALLOC:
-    cache_writealloc = TRUE;
+    sim->cache_writealloc = TRUE;
     break;
   case CACHE_PARAM_NOWRITEALLOC:
-    cache_writealloc = FALSE;
+    sim->cache_writealloc = FALSE;
     break;
   case CACHE_PARAM_DEBUG:
-    debug = TRUE;
+    sim->debug = TRUE;
+    break;
+  case CACHE_PARAM_REPLACEMENT:
+    sim->replacement = value;
+    break;
+  case CACHE_PARAM_SEED:
+    sim->seed = value;
+    break;
+  case CACHE_PARAM_L2_SIZE:
+    sim->lower_size[0] = value;
+    break;
+  case CACHE_PARAM_L2_ASSOC:
+    sim->lower_assoc[0] = value;
+    break;
+  case CACHE_PARAM_L3_SIZE:
+    sim->lower_size[1] = value;
+    break;
+  case CACHE_PARAM_L3_ASSOC:
+    sim->lower_assoc[1] = value;
+    break;
+  case CACHE_PARAM_INCLUSION:
+    sim->inclusion = value;
+    break;
+  case CACHE_PARAM_PREFETCHER:
+    sim->prefetch_kind = value;
+    break;
+  case CACHE_PARAM_PREFETCH_DEGREE:
+    sim->prefetch_degree = value;
+    break;
+  case CACHE_PARAM_PREFETCH_LATENCY:
+    sim->prefetch_latency = value;
+    break;
+  case CACHE_PARAM_CLASSIFY:
+    sim->classify = value;
+    break;
+  case CACHE_PARAM_VICTIM_ENTRIES:
+    sim->victim_entries = value;
+    break;
+  case CACHE_PARAM_HEATMAP:
+    sim->heatmap = value;
+    break;
+  case CACHE_PARAM_WRITE_BUFFER:
+    sim->wbuf_entries = value;
+    break;
+  case CACHE_PARAM_WB_DRAIN:
+    sim->wbuf_drain = value;
+    break;
+  case CACHE_PARAM_WB_RATE:
+    sim->wbuf_rate = value;
     break;
   default:
     printf("error set_cache_param: bad parameter value\n");
@@ -89,53 +179,78 @@ void set_cache_param(param, value)
 /************************************************************/
 
 /************************************************************/
-// esta función solo es llamada una vez en el archivo main.c
+// esta función es llamada una vez por simulador desde main.c
 // e inicializa las estructuras de cache y cache statistics
-// (definidas en el archivo cache.h)
-void init_cache()
+// (definidas en el archivo cache.h). Regresa -1 sin inicializar
+// nada si la configuración no se puede simular
+int init_cache(sim)
+  Pcache_sim sim;
 {
   // printf("Initializing cache...\n");
   // initialize cache stats
-  init_cache_stats(&cache_stat_inst);
-  init_cache_stats(&cache_stat_data);
+  init_cache_stats(&sim->cache_stat_inst);
+  init_cache_stats(&sim->cache_stat_data);
+
+  // una configuración inválida no se puede simular
+  if (check_cache_config(sim)) {
+    return (-1);
+  }
 
   // partiendo de que se necesita solo un cache
   // se emplea cache de instrucciones como el cache
   // unificado
-  icache.size = cache_isize;
-  icache.associativity = cache_assoc;
-  icache.n_sets = (icache.size) / (cache_block_size * icache.associativity);
-  icache.index_mask = get_index_mask(icache.n_sets, cache_block_size, address_size);
-  icache.index_mask_offset = LOG2(cache_block_size);
-  icache.LRU_head = (Pcache_line *)malloc(sizeof(Pcache_line) * icache.n_sets);
-  initialize_null(icache.LRU_head, icache.n_sets);
-  icache.LRU_tail = (Pcache_line *)malloc(sizeof(Pcache_line) * icache.n_sets);
-  initialize_null(icache.LRU_tail, icache.n_sets);
-  icache.set_contents = (int *)malloc(sizeof(int) * icache.n_sets);
-  initialize_zeros(icache.set_contents, icache.n_sets);
-
-  if (cache_split) {
+  init_cache_level(&sim->icache, sim->cache_split ? sim->cache_isize : sim->cache_usize,
+                   sim->cache_assoc, sim->cache_block_size, sim->replacement, sim->seed);
+
+  if (sim->cache_split) {
     // tenemos que inicializar un cache de datos
-    dcache.size = cache_dsize;
-    dcache.associativity = cache_assoc;
-    dcache.n_sets = (dcache.size) / (cache_block_size * dcache.associativity);
-    dcache.index_mask = get_index_mask(dcache.n_sets, cache_block_size, address_size);
-    dcache.index_mask_offset = LOG2(cache_block_size);
-    dcache.LRU_head = (Pcache_line *)malloc(sizeof(Pcache_line) * dcache.n_sets);
-    initialize_null(dcache.LRU_head, dcache.n_sets);
-    dcache.LRU_tail = (Pcache_line *)malloc(sizeof(Pcache_line) * dcache.n_sets);
-    initialize_null(dcache.LRU_tail, dcache.n_sets);
-    dcache.set_contents = (int *)malloc(sizeof(int) * dcache.n_sets);
-    initialize_zeros(dcache.set_contents, dcache.n_sets);
+    init_cache_level(&sim->dcache, sim->cache_dsize, sim->cache_assoc,
+                     sim->cache_block_size, sim->replacement, sim->seed + 1);
 
     // initializing separate pointers
-    ptr_icache = &icache;
-    ptr_dcache = &dcache;
+    sim->ptr_icache = &sim->icache;
+    sim->ptr_dcache = &sim->dcache;
   } else {
     // directing both pointers to unified cache (icache variable)
-    ptr_icache = &icache;
-    ptr_dcache = &icache;
+    sim->ptr_icache = &sim->icache;
+    sim->ptr_dcache = &sim->icache;
+  }
+
+  // cada cache L1 tiene su propio prefetcher
+  memset(&sim->prefetch_stats, 0, sizeof(prefetch_stat));
+  init_prefetcher(&sim->icache, sim->prefetch_kind, sim->prefetch_degree);
+  if (sim->cache_split) {
+    init_prefetcher(&sim->dcache, sim->prefetch_kind, sim->prefetch_degree);
+  }
+
+  // y, si se pidieron, su sombra para clasificar fallos y su victim cache
+  memset(&sim->class_inst, 0, sizeof(miss_class));
+  memset(&sim->class_data, 0, sizeof(miss_class));
+  memset(&sim->victim_stats, 0, sizeof(victim_stat));
+  init_shadow(&sim->icache, sim->classify);
+  init_victim(&sim->icache, sim->victim_entries);
+  if (sim->cache_split) {
+    init_shadow(&sim->dcache, sim->classify);
+    init_victim(&sim->dcache, sim->victim_entries);
+  }
+  // y el mapa de calor de -hm
+  init_heatmap(sim);
+  // las escrituras write through pasan por el buffer de escritura
+  memset(&sim->wbuf_stats, 0, sizeof(write_buffer_stat));
+  init_write_buffer(sim);
+
+  // niveles unificados L2 y L3 (L3 solo si hay L2); comparten
+  // el tamaño de bloque y la política de reemplazo de L1
+  sim->n_lower = 0;
+  sim->flushing = FALSE;
+  while (sim->n_lower < MAX_LOWER_LEVELS && sim->lower_size[sim->n_lower] > 0) {
+    int k = sim->n_lower++;
+    init_cache_stats(&sim->lower_stat[k]);
+    init_cache_level(&sim->lower[k], sim->lower_size[k], sim->lower_assoc[k],
+                     sim->cache_block_size, sim->replacement, sim->seed + 2 + k);
   }
+  sim->initialized = TRUE;
+  return (0);
 }
 /************************************************************/
 
@@ -143,8 +258,10 @@ void init_cache()
 // esta función es llamada en cada iteración de la función 
 // play_trace() del archivo main.c. Simula una referencia a
 // memoria del cache
-void perform_access(addr, access_type)
-  unsigned addr, access_type;
+void perform_access(sim, addr, access_type)
+  Pcache_sim sim;
+  sim_addr addr;
+  unsigned access_type;
 {
   /*
   * ACCESS TYPE
@@ -153,206 +270,332 @@ void perform_access(addr, access_type)
   * 2 - Instruction load reference
   */
   // printf("Performing access type %d - ", access_type);
-  // conteo del número de veces que se accede a memoria por el
-  // procesador
-  countAccesses(access_type);
 
   // obtenemos en qué línea/banco le corresponde a la
   // dirección de memoria 
-  int index = getLineIndex(addr, access_type);
+  Pcache ptr_cache = (access_type < 2) ? sim->ptr_dcache : sim->ptr_icache;
+  int index = getLineIndex(ptr_cache, addr);
+  sim_addr tag = getTag(ptr_cache, addr);
   // printf("Using line index %d - ", index);
 
-  // se verifica si el cache correspondiente contiene
-  // una línea con ese tag o no
-  int is_hit = isHit(addr, access_type, index);
+  apply_access(sim, access_type, index, tag, addr);
+}
+/************************************************************/
+
+/************************************************************/
+/* full_insert() of an L1 miss, timed when built with -DSIM_PROFILE */
+static inline insertion_response l1_insert(Pcache_sim sim, Pcache ptr_cache, int index, sim_addr tag) {
+  PROFILE_START(start);
+  insertion_response response = full_insert(ptr_cache, index, tag);
+  PROFILE_STOP(&sim->profile, PROFILE_REPLACE, start);
+  if (ptr_cache->heat) {
+    heatmap_evict(sim, ptr_cache, index, &response);
+  }
+  return response;
+}
+
+/* a store that goes through L1 to the next level: one word of
+ * traffic, or an entry of the write buffer if there is one */
+static void write_through(Pcache_sim sim, sim_addr addr) {
+  if (sim->wbuf) {
+    write_buffer_store(sim, addr);
+    return;
+  }
+  COUNT_COPY_BACK(&sim->cache_stat_data, 1); // += words_per_block;?
+  if (sim->n_lower) {
+    hierarchy_write(sim, addr >> sim->ptr_dcache->index_mask_offset << sim->ptr_dcache->index_mask_offset);
+  }
+}
+
+// aplica una referencia cuyo set y tag ya se calcularon: busca
+// la línea, actualiza el cache y las estadísticas. Es el núcleo
+// común de perform_access() y perform_access_batch(); addr solo
+// hace falta para las escrituras write through
+void apply_access(sim, access_type, index, tag, addr)
+  Pcache_sim sim;
+  unsigned access_type;
+  int index;
+  sim_addr tag;
+  sim_addr addr;
+{
+  PROFILE_START(start);
+  // conteo del número de veces que se accede a memoria por el
+  // procesador
+  countAccesses(sim, access_type);
+
+  // cache sobre el que se hace la referencia: las cargas y
+  // escrituras de datos van al cache de datos, las instrucciones
+  // al de instrucciones (ambos apuntan al mismo si es unificado)
+  Pcache ptr_cache = (access_type < 2) ? sim->ptr_dcache : sim->ptr_icache;
+
+  // se busca la línea una sola vez; way es su posición dentro
+  // del set o -1 si el cache correspondiente no la contiene
+  PROFILE_START(lookup);
+  int way = get_line_way(ptr_cache, index, tag);
+  PROFILE_STOP(&sim->profile, PROFILE_LOOKUP, lookup);
+  int is_hit = way >= 0;
+  // fetch es el número de bloques que se piden abajo en un fallo:
+  // 0 si el bloque ya estaba en el victim cache o en un stream
+  // buffer del prefetcher. allocate es FALSE si un fallo no trae
+  // el bloque (escritura con no write allocate)
+  int fetch = 1, buffered = PREFETCH_NOT_BUFFERED, prefetched = FALSE;
+  int allocate = access_type != 1 || sim->cache_writealloc;
 
   // printf("%s...\n", (is_hit ? "HIT" : "MISS"));
 
   // conteo de número de misses
   if (access_type < 2) {
-    cache_stat_data.misses += !is_hit;
+    sim->cache_stat_data.misses += !is_hit;
   } else {
-    cache_stat_inst.misses += !is_hit;
+    sim->cache_stat_inst.misses += !is_hit;
+  }
+  if (ptr_cache->shadow) {
+    classify_access(sim, ptr_cache, access_type, index, tag, is_hit, allocate);
+  }
+  if (ptr_cache->heat) {
+    heatmap_access(sim, ptr_cache, access_type, index, tag, is_hit);
   }
 
   // bloque de código para cuando no hubo un hit
   if (!is_hit) {
+    insertion_response response;
+    if (ptr_cache->victim && allocate) {
+      int dirty = victim_probe(sim, ptr_cache, index, tag);
+      if (dirty >= 0) {
+        buffered = dirty ? PREFETCH_BUFFERED_DIRTY : PREFETCH_BUFFERED;
+      }
+    }
+    if (ptr_cache->prefetcher) {
+      int in_stream = prefetch_miss(sim, ptr_cache, index, tag,
+                                    allocate && buffered == PREFETCH_NOT_BUFFERED);
+      if (in_stream != PREFETCH_NOT_BUFFERED) {
+        buffered = in_stream;
+        prefetched = TRUE;
+      }
+    }
+    fetch = buffered == PREFETCH_NOT_BUFFERED;
     if (access_type == 0) {
       // lectura de bloque 
-      Pinsertion_response ptr_response = full_insert(addr, ptr_dcache, index);
-      cache_stat_data.replacements += ptr_response->replacement;
-      cache_stat_data.demand_fetches += words_per_block;
-      cache_stat_data.copies_back += ptr_response->dirty_bit * words_per_block;
-      free(ptr_response);
+      response = l1_insert(sim, sim->ptr_dcache, index, tag);
+      sim->cache_stat_data.replacements += response.replacement;
+      victim_insert(sim, ptr_cache, index, &response);
+      COUNT_DEMAND_FETCH(&sim->cache_stat_data, fetch * sim->words_per_block);
+      COUNT_COPY_BACK(&sim->cache_stat_data, response.dirty_bit * sim->words_per_block);
+      if (sim->n_lower) {
+        hierarchy_fill(sim, sim->ptr_dcache, index, tag, response, fetch);
+      }
     } else if (access_type == 1) {
       // escritura a memoria
-      if (cache_writealloc) {
+      if (sim->cache_writealloc) {
         // traer a cache y escribir de acuerdo con política de hit write
-        // TODO: aquí hay que insertarlo sucio
-        Pinsertion_response ptr_response = full_insert(addr, ptr_dcache, index);
-        cache_stat_data.replacements += ptr_response->replacement;
-        cache_stat_data.demand_fetches += words_per_block;
+        response = l1_insert(sim, sim->ptr_dcache, index, tag);
+        sim->cache_stat_data.replacements += response.replacement;
+        victim_insert(sim, ptr_cache, index, &response);
+        COUNT_DEMAND_FETCH(&sim->cache_stat_data, fetch * sim->words_per_block);
 
-        if (cache_writeback) {
+        if (sim->cache_writeback) {
           // incrementamos en uno la estadística de copies back
           // si la línea removida había sido modificada y tenemos
-          // política de write back
-          Pcache_line ptr_inserted_line = get_referenced_line(ptr_dcache, addr, index);
-          ptr_inserted_line->dirty = TRUE;
-          cache_stat_data.copies_back += ptr_response->dirty_bit * words_per_block;
-        } else {
-          cache_stat_data.copies_back += 1; // += words_per_block;?
+          // política de write back; la línea se inserta sucia
+          sim->ptr_dcache->lines[index * sim->ptr_dcache->associativity + response.way].dirty = TRUE;
+          COUNT_COPY_BACK(&sim->cache_stat_data, response.dirty_bit * sim->words_per_block);
+        }
+        if (sim->n_lower) {
+          hierarchy_fill(sim, sim->ptr_dcache, index, tag, response, fetch);
+        }
+        if (!sim->cache_writeback) {
+          write_through(sim, addr);
         }
-        free(ptr_response);
       } else {
-        cache_stat_data.copies_back += 1; // += words_per_block;?
+        write_through(sim, addr);
       }
     } else if (access_type == 2) {
-        Pinsertion_response ptr_response = full_insert(addr, ptr_icache, index);
-        cache_stat_inst.replacements += ptr_response->replacement;
-        cache_stat_inst.demand_fetches += words_per_block;
-        if (!cache_split) {
+        response = l1_insert(sim, sim->ptr_icache, index, tag);
+        sim->cache_stat_inst.replacements += response.replacement;
+        victim_insert(sim, ptr_cache, index, &response);
+        COUNT_DEMAND_FETCH(&sim->cache_stat_inst, fetch * sim->words_per_block);
+        if (!sim->cache_split) {
           // Cargar una instrucción puede borrar un dato 
           // por lo que hay que revisar también el dirty bit
-          cache_stat_data.copies_back += ptr_response->dirty_bit * words_per_block /* * cache_writeback? */;
+          COUNT_COPY_BACK(&sim->cache_stat_data, response.dirty_bit * sim->words_per_block /* * cache_writeback? */);
         }
-        free(ptr_response);
+        if (sim->n_lower) {
+          hierarchy_fill(sim, sim->ptr_icache, index, tag, response, fetch);
+        }
+    }
+    // un bloque sucio que venía del victim cache o de L2 en un stream
+    // buffer (jerarquía exclusiva) sigue sucio en L1
+    if (buffered == PREFETCH_BUFFERED_DIRTY) {
+      ptr_cache->lines[index * ptr_cache->associativity + response.way].dirty = TRUE;
     }
   }
 
   // bloque de código si hubo hit
   if (is_hit) {
-    if (access_type == 0) {
-      // busque datos para lectura en cache y estaban
-      reinsert_at_head(ptr_dcache, addr, index);
-    } else if (access_type == 1) {
+    // el primer uso de una línea traída por el prefetcher
+    if (ptr_cache->prefetcher) {
+      prefetched = prefetch_hit(sim, ptr_cache, index, way);
+    }
+    // la línea referenciada pasa a ser la más recientemente usada
+    touch_line(ptr_cache, index, way);
+    if (access_type == 1) {
       // quise escribir en localidad de memoria y estaba en cache
-      reinsert_at_head(ptr_dcache, addr, index);
-      if (cache_writeback) {
+      if (sim->cache_writeback) {
         // escribo solo en cache por lo que hay que modificar el dirty bit
-        Pcache_line wrote_line = get_referenced_line(ptr_dcache, addr, index);
-        wrote_line->dirty = 1;
-        reinsert_at_head(ptr_dcache, addr, index);
+        ptr_cache->lines[index * ptr_cache->associativity + way].dirty = 1;
       } else {
         // entonces se tiene writethrough por lo que se puede ignorar
         // dirty bit
-        reinsert_at_head(ptr_dcache, addr, index);
-        cache_stat_data.copies_back += 1;
+        write_through(sim, addr);
       }
-    } else if (access_type == 2) {
-      // busque una instrucción en cache y estaba
-      reinsert_at_head(ptr_icache, addr, index);
     }
   }
+
+  // el prefetcher aprende de cada referencia y pide bloques al final,
+  // cuando la línea referenciada ya no se va a tocar
+  if (ptr_cache->prefetcher) {
+    prefetch_issue(sim, ptr_cache, index, tag, is_hit, prefetched);
+  }
+  PROFILE_STOP(&sim->profile, PROFILE_ACCESS, start);
 }
 /************************************************************/
 
 /************************************************************/
-// es llamada una vez antes de finalizar la función play_trace()
-// del archivo main.c. Sirve para eliminar todos los contenidos de
-// la memoria cache.
-void flush()
+/* helper function to tell whether the instruction and data streams
+ * of sim share no state, so that each one can be applied apart.
+ * Any feature that both streams touch (a shared level, a clock
+ * counted in references of both) must be checked here */
+static int streams_independent(Pcache_sim sim) {
+  // L2 y L3 son de los dos; prefetch_now() y el buffer de escritura
+  // miden el tiempo con las referencias de ambos, y la tabla de
+  // regiones de -hm reparte sus entradas en orden de llegada
+  return sim->cache_split && !sim->n_lower && sim->prefetch_kind == PREFETCH_NONE && !sim->wbuf &&
+         !sim->regions;
+}
+
+// simula n referencias de un jalón; types[i] y addrs[i] describen
+// la i-ésima y todos los tipos deben ser válidos. Por cada bloque
+// de ACCESS_BATCH referencias primero se calculan todos los sets
+// y tags en un ciclo sin dependencias entre iteraciones (que el
+// compilador puede vectorizar) y después se aplican en orden.
+// Cuando los flujos de instrucciones y de datos no comparten nada
+// (streams_independent()) se aplican en dos pasadas, una por flujo;
+// si no, se respeta el orden original, así que los resultados son
+// los mismos que con perform_access().
+void perform_access_batch(sim, types, addrs, n)
+  Pcache_sim sim;
+  const unsigned char *types;
+  const sim_addr *addrs;
+  int n;
 {
-  if (debug) {
-    printf("Flushing cache...\n");
-  }
-  free_structure(ptr_icache);
-  free_cache_resources(ptr_icache);
+  int index[ACCESS_BATCH];
+  sim_addr tag[ACCESS_BATCH];
+  int base, count, i;
+
+  // geometría de cada cache, calculada una vez por llamada
+  unsigned i_mask = sim->ptr_icache->index_mask, d_mask = sim->ptr_dcache->index_mask;
+  int i_offset = sim->ptr_icache->index_mask_offset, d_offset = sim->ptr_dcache->index_mask_offset;
+  int i_shift = sim->ptr_icache->tag_shift, d_shift = sim->ptr_dcache->tag_shift;
 
-  if (cache_split) {
-    free_structure(ptr_dcache);
-    free_cache_resources(ptr_dcache);
+  for (base = 0; base < n; base += ACCESS_BATCH) {
+    const unsigned char *t = types + base;
+    const sim_addr *a = addrs + base;
+    count = (n - base < ACCESS_BATCH) ? n - base : ACCESS_BATCH;
+
+    for (i = 0; i < count; i++) {
+      int inst = t[i] == TRACE_INST_LOAD;
+      index[i] = (a[i] & (inst ? i_mask : d_mask)) >> (inst ? i_offset : d_offset);
+      tag[i] = a[i] >> (inst ? i_shift : d_shift);
+    }
+
+    if (streams_independent(sim)) {
+      for (i = 0; i < count; i++)
+        if (t[i] == TRACE_INST_LOAD)
+          apply_access(sim, t[i], index[i], tag[i], a[i]);
+      for (i = 0; i < count; i++)
+        if (t[i] != TRACE_INST_LOAD)
+          apply_access(sim, t[i], index[i], tag[i], a[i]);
+    } else {
+      for (i = 0; i < count; i++)
+        apply_access(sim, t[i], index[i], tag[i], a[i]);
+    }
   }
 }
 /************************************************************/
 
 /************************************************************/
-// esta función es útil para simular asociatividad de la memoria
-// cache. Específicamente, se utiliza para eliminar una línea de
-// cache contenida en un banco. Esto puede suceder tanto cuando
-// se quiere eliminar como cuando se hace referencia a una línea
-// bajo el esquema de reposición Least Recently Used.
-void delete(head, tail, item)
-  Pcache_line *head, *tail; // apuntadores a apuntadores de líneas
-  Pcache_line item; // apuntador de línea
+// es llamada una vez antes de finalizar la función play_trace()
+// del archivo main.c. Sirve para eliminar todos los contenidos de
+// la memoria cache: las líneas sucias se escriben a memoria y los
+// sets quedan vacíos, pero el cache se puede seguir usando.
+void flush(sim)
+  Pcache_sim sim;
 {
-  if (item->LRU_prev) {
-    item->LRU_prev->LRU_next = item->LRU_next;
-  } else {
-    /* item at head */
-    *head = item->LRU_next;
+  if (sim->debug) {
+    printf("Flushing cache...\n");
   }
-
-  if (item->LRU_next) {
-    item->LRU_next->LRU_prev = item->LRU_prev;
-  } else {
-    /* item at tail */
-    *tail = item->LRU_prev;
+  // mientras se vacían los niveles no se invalida nada hacia arriba:
+  // cada nivel se vacía después de los que tiene encima
+  sim->flushing = TRUE;
+  write_buffer_flush(sim);
+  prefetch_flush(sim, sim->ptr_icache);
+  victim_flush(sim, sim->ptr_icache);
+  if (sim->cache_split) {
+    prefetch_flush(sim, sim->ptr_dcache);
+    victim_flush(sim, sim->ptr_dcache);
   }
-}
-/************************************************************/
+  free_structure(sim, sim->ptr_icache);
 
-/************************************************************/
-// Inserta una línea de cache en la cabeza de la lista 
-// a.k.a. cabeza del banco
-void insert(head, tail, item)
-  Pcache_line *head, *tail; // apuntadores a apuntadores de líneas
-  Pcache_line item; // apuntador a línea
-{
-  // el item apunta en next a la dirección que apuntaba la cabeza del banco
-  item->LRU_next = *head;
-  // pointer casting
-  item->LRU_prev = (Pcache_line)NULL;
-
-  // verificando si el item insertado no era el primero del banco
-  if (item->LRU_next)
-    // ya hay otro elemento en el banco
-    // hacemos que el item que estaba antes en la cabeza apunte
-    // al nuevo item agregado
-    item->LRU_next->LRU_prev = item;
-  else
-    // de lo contario, la cola debe apuntar al nuevo item insertado
-    *tail = item;
-
-  // finalmente la cabeza apunta al item
-  *head = item;
+  if (sim->cache_split) {
+    free_structure(sim, sim->ptr_dcache);
+  }
+  if (sim->n_lower) {
+    hierarchy_flush(sim);
+  }
+  sim->flushing = FALSE;
 }
 /************************************************************/
 
 /************************************************************/
 // imprime la configuración de la memoria cache a la consola
-void dump_settings()
+void dump_settings(sim)
+  Pcache_sim sim;
 {
-  if (debug) {
+  if (sim->debug) {
     printf("*** CACHE SETTINGS ***\n");
-    if (cache_split) {
+    if (sim->cache_split) {
       printf("  Split I- D-cache\n");
-      printf("  I-cache size: \t%d\n", cache_isize);
-      printf("  D-cache size: \t%d\n", cache_dsize);
+      printf("  I-cache size: \t%d\n", sim->cache_isize);
+      printf("  D-cache size: \t%d\n", sim->cache_dsize);
     } else {
       printf("  Unified I- D-cache\n");
-      printf("  Size: \t%d\n", cache_usize);
+      printf("  Size: \t%d\n", sim->cache_usize);
     }
-    printf("  Associativity: \t%d\n", cache_assoc);
-    printf("  Block size: \t\t%d\n", cache_block_size);
+    printf("  Associativity: \t%d\n", sim->cache_assoc);
+    printf("  Block size: \t\t%d\n", sim->cache_block_size);
     printf("  Write policy: \t%s\n", 
-    cache_writeback ? "WRITE BACK" : "WRITE THROUGH");
+    sim->cache_writeback ? "WRITE BACK" : "WRITE THROUGH");
     printf("  Allocation policy: \t%s\n",
-    cache_writealloc ? "WRITE ALLOCATE" : "WRITE NO ALLOCATE");
+    sim->cache_writealloc ? "WRITE ALLOCATE" : "WRITE NO ALLOCATE");
+    printf("  Replacement policy: \t%s\n", replacement_name(sim->replacement));
+    dump_prefetch_settings(sim);
+    dump_victim_settings(sim);
+    dump_write_buffer_settings(sim);
+    dump_lower_settings(sim);
   } else {
-    if (cache_split) {
-      printf("%d,", cache_isize);
-      printf("%d,", cache_dsize);
+    if (sim->cache_split) {
+      printf("%d,", sim->cache_isize);
+      printf("%d,", sim->cache_dsize);
       printf("%d,", 0);
     } else {
       printf("%d,", 0);
       printf("%d,", 0);
-      printf("%d,", cache_usize);
+      printf("%d,", sim->cache_usize);
     }
-    printf("%d,", cache_assoc);
-    printf("%d,", cache_block_size);
-    printf("%s,", cache_writeback ? "WRITE BACK" : "WRITE THROUGH");
-    printf("%s,", cache_writealloc ? "WRITE ALLOCATE" : "WRITE NO ALLOCATE");
+    printf("%d,", sim->cache_assoc);
+    printf("%d,", sim->cache_block_size);
+    printf("%s,", sim->cache_writeback ? "WRITE BACK" : "WRITE THROUGH");
+    printf("%s,", sim->cache_writealloc ? "WRITE ALLOCATE" : "WRITE NO ALLOCATE");
   }
 }
 /************************************************************/
@@ -362,94 +605,256 @@ void dump_settings()
 // simulación del cache a través de los archivos *.trace. 
 // Estas estadísticas deben de ser actualizadas dentro de 
 // perform_access().
-void print_stats()
+void print_stats(sim)
+  Pcache_sim sim;
 {
-  if (debug) {
+  if (sim->debug) {
     printf("\n*** CACHE STATISTICS ***\n");
+    printf(" REPLACEMENT POLICY: %s\n", replacement_name(sim->replacement));
 
     printf(" INSTRUCTIONS\n");
-    printf("  accesses:  %d\n", cache_stat_inst.accesses);
-    printf("  misses:    %d\n", cache_stat_inst.misses);
-    if (!cache_stat_inst.accesses)
+    printf("  accesses:  %lld\n", sim->cache_stat_inst.accesses);
+    printf("  misses:    %lld\n", sim->cache_stat_inst.misses);
+    if (!sim->cache_stat_inst.accesses)
       printf("  miss rate: 0 (0)\n"); 
     else
       printf("  miss rate: %2.4f (hit rate %2.4f)\n", 
-    (float)cache_stat_inst.misses / (float)cache_stat_inst.accesses,
-    1.0 - (float)cache_stat_inst.misses / (float)cache_stat_inst.accesses);
-    printf("  replace:   %d\n", cache_stat_inst.replacements);
+    (float)sim->cache_stat_inst.misses / (float)sim->cache_stat_inst.accesses,
+    1.0 - (float)sim->cache_stat_inst.misses / (float)sim->cache_stat_inst.accesses);
+    printf("  replace:   %lld\n", sim->cache_stat_inst.replacements);
 
     printf(" DATA\n");
-    printf("  accesses:  %d\n", cache_stat_data.accesses);
-    printf("  misses:    %d\n", cache_stat_data.misses);
-    if (!cache_stat_data.accesses)
+    printf("  accesses:  %lld\n", sim->cache_stat_data.accesses);
+    printf("  misses:    %lld\n", sim->cache_stat_data.misses);
+    if (!sim->cache_stat_data.accesses)
       printf("  miss rate: 0 (0)\n"); 
     else
       printf("  miss rate: %2.4f (hit rate %2.4f)\n", 
-    (float)cache_stat_data.misses / (float)cache_stat_data.accesses,
-    1.0 - (float)cache_stat_data.misses / (float)cache_stat_data.accesses);
-    printf("  replace:   %d\n", cache_stat_data.replacements);
+    (float)sim->cache_stat_data.misses / (float)sim->cache_stat_data.accesses,
+    1.0 - (float)sim->cache_stat_data.misses / (float)sim->cache_stat_data.accesses);
+    printf("  replace:   %lld\n", sim->cache_stat_data.replacements);
 
     printf(" TRAFFIC (in words)\n");
-    printf("  demand fetch:  %d\n", cache_stat_inst.demand_fetches + 
-    cache_stat_data.demand_fetches);
-    printf("  copies back:   %d\n", cache_stat_inst.copies_back +
-    cache_stat_data.copies_back);
+    printf("  demand fetch:  %lld\n", sim->cache_stat_inst.demand_fetches + 
+    sim->cache_stat_data.demand_fetches);
+    printf("  copies back:   %lld\n", sim->cache_stat_inst.copies_back +
+    sim->cache_stat_data.copies_back);
+    printf(" TRAFFIC (in bytes)\n");
+    printf("  demand fetch:  %lld\n", sim->cache_stat_inst.demand_bytes +
+    sim->cache_stat_data.demand_bytes);
+    printf("  copies back:   %lld\n", sim->cache_stat_inst.copies_back_bytes +
+    sim->cache_stat_data.copies_back_bytes);
     printf("\n");
+    print_prefetch_stats(sim);
+    print_classify_stats(sim);
+    print_victim_stats(sim);
+    print_write_buffer_stats(sim);
+    print_lower_stats(sim);
   } else {
-    printf("%d,", cache_stat_inst.accesses);
-    printf("%d,", cache_stat_inst.misses);
-    if (!cache_stat_inst.accesses)
+    printf("%lld,", sim->cache_stat_inst.accesses);
+    printf("%lld,", sim->cache_stat_inst.misses);
+    if (!sim->cache_stat_inst.accesses)
       printf("0,0,"); 
     else
       printf("%2.4f,%2.4f,", 
-    (float)cache_stat_inst.misses / (float)cache_stat_inst.accesses,
-    1.0 - (float)cache_stat_inst.misses / (float)cache_stat_inst.accesses);
-    printf("%d,", cache_stat_inst.replacements);
+    (float)sim->cache_stat_inst.misses / (float)sim->cache_stat_inst.accesses,
+    1.0 - (float)sim->cache_stat_inst.misses / (float)sim->cache_stat_inst.accesses);
+    printf("%lld,", sim->cache_stat_inst.replacements);
 
-    printf("%d,", cache_stat_data.accesses);
-    printf("%d,", cache_stat_data.misses);
-    if (!cache_stat_data.accesses)
+    printf("%lld,", sim->cache_stat_data.accesses);
+    printf("%lld,", sim->cache_stat_data.misses);
+    if (!sim->cache_stat_data.accesses)
       printf("0,0,"); 
     else
       printf("%2.4f,%2.4f,", 
-    (float)cache_stat_data.misses / (float)cache_stat_data.accesses,
-    1.0 - (float)cache_stat_data.misses / (float)cache_stat_data.accesses);
-    printf("%d,", cache_stat_data.replacements);
-
-    printf("%d,", cache_stat_inst.demand_fetches + 
-    cache_stat_data.demand_fetches);
-    printf("%d", cache_stat_inst.copies_back +
-    cache_stat_data.copies_back);
+    (float)sim->cache_stat_data.misses / (float)sim->cache_stat_data.accesses,
+    1.0 - (float)sim->cache_stat_data.misses / (float)sim->cache_stat_data.accesses);
+    printf("%lld,", sim->cache_stat_data.replacements);
+
+    printf("%lld,", sim->cache_stat_inst.demand_fetches + 
+    sim->cache_stat_data.demand_fetches);
+    printf("%lld,", sim->cache_stat_inst.copies_back +
+    sim->cache_stat_data.copies_back);
+    printf("%s", replacement_name(sim->replacement));
+    print_prefetch_stats(sim);
+    print_classify_stats(sim);
+    print_victim_stats(sim);
+    print_write_buffer_stats(sim);
+    print_lower_stats(sim);
     printf("\n");
   }
+#if defined(SIM_PROFILE)
+  print_profile(sim);
+#endif
 }
 /************************************************************/
 
 /************************************************************/
-/* helper function to calculate inex mask*/
-int get_index_mask(int n_sets, int words_per_block, int address_size) {
-  int w = LOG2(words_per_block);
-  int x = LOG2(n_sets);
-  unsigned mask = 0;
+/* helper function to get log2 of a power of two, -1 otherwise */
+int log2_int(unsigned x) {
+  int bits = 0;
+
+  if (x == 0 || (x & (x - 1))) {
+    return -1;
+  }
+  while (x >>= 1) {
+    bits++;
+  }
+  return bits;
+}
+
+/* helper function to list the size and associativity of every
+ * cache of sim (L1 and the levels below); returns how many there are
+*/
+static int cache_levels(Pcache_sim sim, int *sizes, int *assocs) {
+  int n = 0;
+
+  if (sim->cache_split) {
+    sizes[n] = sim->cache_isize;
+    assocs[n++] = sim->cache_assoc;
+    sizes[n] = sim->cache_dsize;
+    assocs[n++] = sim->cache_assoc;
+  } else {
+    sizes[n] = sim->cache_usize;
+    assocs[n++] = sim->cache_assoc;
+  }
+  for (int k = 0; k < MAX_LOWER_LEVELS && sim->lower_size[k] > 0; k++) {
+    sizes[n] = sim->lower_size[k];
+    assocs[n++] = sim->lower_assoc[k];
+  }
+  return n;
+}
+
+/* helper function to check that a configuration can be simulated:
+ * block size and number of sets must be powers of two, so that
+ * set index and tag are plain shifts and masks of the address.
+ * Prints the problem and returns -1 if the configuration is invalid
+*/
+int check_cache_config(Pcache_sim sim) {
+  int sizes[2 + MAX_LOWER_LEVELS], assocs[2 + MAX_LOWER_LEVELS], n;
 
-  for (int i = 0; i < x; i++) {
-    mask += pow(2, i);
+  if (log2_int(sim->cache_block_size) < 0 || sim->cache_block_size < WORD_SIZE) {
+    printf("error:  block size %d is not a power of two of at least %d bytes\n",
+    sim->cache_block_size, WORD_SIZE);
+    return -1;
+  }
+  if (sim->lower_size[1] > 0 && sim->lower_size[0] <= 0) {
+    printf("error:  an L3 cache needs an L2 cache\n");
+    return -1;
   }
 
-  return mask << w;
+  n = cache_levels(sim, sizes, assocs);
+  for (int i = 0; i < n; i++) {
+    int set_bytes = sim->cache_block_size * assocs[i];
+    if (assocs[i] < 1) {
+      printf("error:  associativity %d must be at least 1\n", assocs[i]);
+      return -1;
+    }
+    if (sim->replacement == REPLACE_PLRU &&
+        (log2_int(assocs[i]) < 0 || assocs[i] > PLRU_MAX_ASSOC)) {
+      printf("error:  PLRU needs a power of two associativity up to %d\n", PLRU_MAX_ASSOC);
+      return -1;
+    }
+    if (sizes[i] < set_bytes || sizes[i] % set_bytes || log2_int(sizes[i] / set_bytes) < 0) {
+      printf("error:  cache size %d is not a power of two number of %d-way sets of %d bytes\n",
+      sizes[i], assocs[i], sim->cache_block_size);
+      return -1;
+    }
+  }
+  if (sim->prefetch_degree < 1 || sim->prefetch_latency < 0) {
+    printf("error:  prefetch degree must be at least 1 and latency not negative\n");
+    return -1;
+  }
+  if (sim->victim_entries < 0) {
+    printf("error:  the victim cache cannot have %d blocks\n", sim->victim_entries);
+    return -1;
+  }
+  if (sim->wbuf_entries < 0 || sim->wbuf_rate < 1) {
+    printf("error:  the write buffer needs 0 or more entries and a rate of at least 1\n");
+    return -1;
+  }
+  return 0;
 }
 
-/* helper function to initialize array with zeros */
-void initialize_zeros(int *array, int number_of_items) {
-  for (int i = 0; i < number_of_items; i++) {
-    array[i] = 0;
+/* helper function to check that the sets of every cache of sim can
+ * be split in 2^shard_bits shards by the address bits [shard_shift,
+ * shard_shift + shard_bits): they must be set index bits of every
+ * level, and no part of the simulation may look across sets. Prints
+ * the problem and returns -1 otherwise
+*/
+int check_shard_config(Pcache_sim sim, int shard_shift, int shard_bits) {
+  int sizes[2 + MAX_LOWER_LEVELS], assocs[2 + MAX_LOWER_LEVELS], n, offset;
+
+  if (check_cache_config(sim)) {
+    return -1;
+  }
+  // random y brrip sacan sus números de una sola secuencia para
+  // todos los sets; el prefetcher, el victim cache y la sombra de
+  // -3c ven bloques de cualquier set
+  if (sim->replacement == REPLACE_RANDOM || sim->replacement == REPLACE_BRRIP) {
+    printf("error:  %s replacement cannot be split by sets\n", replacement_name(sim->replacement));
+    return -1;
+  }
+  if (sim->prefetch_kind != PREFETCH_NONE || sim->victim_entries > 0 || sim->classify || sim->heatmap ||
+      (sim->wbuf_entries > 0 && !sim->cache_writeback)) {
+    printf("error:  prefetchers, victim caches, write buffers, -3c and -hm cannot be split by sets\n");
+    return -1;
+  }
+
+  offset = log2_int(sim->cache_block_size);
+  n = cache_levels(sim, sizes, assocs);
+  for (int i = 0; i < n; i++) {
+    int index_bits = log2_int(sizes[i] / (sim->cache_block_size * assocs[i]));
+    if (shard_shift < offset || shard_shift + shard_bits > offset + index_bits) {
+      printf("error:  cache size %d has too few %d-byte sets to split in %d shards\n",
+      sizes[i], sim->cache_block_size, 1 << shard_bits);
+      return -1;
+    }
   }
+  return 0;
 }
 
-/* helper function to initialize array with NULL */
-void initialize_null(Pcache_line *array, int number_of_items) {
+/* helper function to compute, once, the shifts and masks that
+ * split an address into tag | set index | block offset
+*/
+void set_cache_geometry(Pcache ptr_cache, int block_size) {
+  ptr_cache->n_sets = ptr_cache->size / (block_size * ptr_cache->associativity);
+  ptr_cache->index_mask_offset = log2_int(block_size);
+  ptr_cache->index_mask = (ptr_cache->n_sets - 1) << ptr_cache->index_mask_offset;
+  ptr_cache->tag_shift = ptr_cache->index_mask_offset + log2_int(ptr_cache->n_sets);
+}
+
+/* allocates the lines of one cache and sets up its geometry
+ * and replacement state
+*/
+void init_cache_level(Pcache ptr_cache, int size, int associativity, int block_size,
+                      int policy, unsigned seed) {
+  ptr_cache->size = size;
+  ptr_cache->associativity = associativity;
+  set_cache_geometry(ptr_cache, block_size);
+  ptr_cache->lines = (Pcache_line)calloc(ptr_cache->n_sets * associativity, sizeof(cache_line));
+  ptr_cache->tag_bytes = sizeof(unsigned);
+  ptr_cache->tags = calloc(ptr_cache->n_sets * associativity + CACHE_TAG_LANES, ptr_cache->tag_bytes);
+  ptr_cache->set_contents = (int *)malloc(sizeof(int) * ptr_cache->n_sets);
+  initialize_zeros(ptr_cache->set_contents, ptr_cache->n_sets);
+  init_replacement(ptr_cache, policy, seed);
+  ptr_cache->prefetcher = NULL;
+  ptr_cache->shadow = NULL;
+  ptr_cache->victim = NULL;
+  ptr_cache->heat = NULL;
+}
+
+/* helper function to rebuild the address of the first byte
+ * of a block from its set and tag
+*/
+sim_addr block_address(Pcache ptr_cache, int set_index, sim_addr tag) {
+  return (tag << ptr_cache->tag_shift) | ((sim_addr)set_index << ptr_cache->index_mask_offset);
+}
+
+/* helper function to initialize array with zeros */
+void initialize_zeros(int *array, int number_of_items) {
   for (int i = 0; i < number_of_items; i++) {
-    array[i] = (Pcache_line)NULL;
+    array[i] = 0;
   }
 }
 
@@ -460,21 +865,28 @@ void init_cache_stats(Pcache_stat c_stats) {
   c_stats->replacements = 0;
   c_stats->demand_fetches = 0;
   c_stats->copies_back = 0;
+  c_stats->demand_bytes = 0;
+  c_stats->copies_back_bytes = 0;
 }
 
-/* Responsible of empty memory from a Pcache_line */
-void emptyCacheLine(Pcache_line *line) {
-  free(line);
-  if (debug) {
-    printf("Free memory from Cache Line\n");
+/* helper function to zero every counter of sim at the end of the
+ * warm-up; the contents of the caches stay as they are
+*/
+void reset_stats(Pcache_sim sim) {
+  // el prefetcher mide el tiempo con el número de accesos
+  sim->clock_base += sim->cache_stat_inst.accesses + sim->cache_stat_data.accesses;
+  init_cache_stats(&sim->cache_stat_inst);
+  init_cache_stats(&sim->cache_stat_data);
+  for (int k = 0; k < MAX_LOWER_LEVELS; k++) {
+    init_cache_stats(&sim->lower_stat[k]);
   }
-}
-
-/* Responsible of empty memory from a int */
-void emptyInt(int *number) {
-  free(number);
-  if (debug) {
-    printf("Free memory from Integer\n");  
+  memset(&sim->prefetch_stats, 0, sizeof(prefetch_stat));
+  memset(&sim->class_inst, 0, sizeof(miss_class));
+  memset(&sim->class_data, 0, sizeof(miss_class));
+  memset(&sim->victim_stats, 0, sizeof(victim_stat));
+  memset(&sim->wbuf_stats, 0, sizeof(write_buffer_stat));
+  if (sim->regions) {
+    heatmap_reset(sim);
   }
 }
 
@@ -498,15 +910,14 @@ void print_array_ints(int *array, int number_of_items) {
   printf("]\n");
 }
 
-/* helper function to print array cache line address */
-void print_array_lines(Pcache_line *array, int number_of_items) {
+/* helper function to print the tags stored in a cache set */
+void print_array_lines(Pcache ptr_cache, int set_index) {
+  Pcache_line array = &ptr_cache->lines[set_index * ptr_cache->associativity];
+  int number_of_items = ptr_cache->set_contents[set_index];
   printf("[");
   for (int i = 0; i < number_of_items; i++) {
-    if (array[i] != NULL) {
-      printf("LINE");
-    } else {
-      printf("NULL");
-    }
+    printf("%llx%s", line_tag(ptr_cache, set_index * ptr_cache->associativity + i),
+    array[i].dirty ? "*" : "");
     if (i < (number_of_items - 1)) {
       printf(", ");
     }
@@ -514,182 +925,467 @@ void print_array_lines(Pcache_line *array, int number_of_items) {
   printf("]\n");
 }
 
-/* helper function to debug cache */
-void print_cache_status() {
+/* helper function to sim->debug cache */
+void print_cache_status(Pcache_sim sim) {
   printf("\n****** CACHE STATUS *******\n\n");
   printf(" INSTRUCTIONS CACHE\n");
-  printf("  size:  %d\n", icache.size);
-  printf("  associativity:  %d\n", icache.associativity);
-  printf("  sets:  %d\n", icache.n_sets);
+  printf("  size:  %d\n", sim->icache.size);
+  printf("  associativity:  %d\n", sim->icache.associativity);
+  printf("  sets:  %d\n", sim->icache.n_sets);
   printf("  mask:  ");
-  print_binary_representation(icache.index_mask);
+  print_binary_representation(sim->icache.index_mask);
   printf("\n");
-  printf("  mask offset:  %d\n", icache.index_mask_offset);
-  printf("  LRU_head:  ");
-  print_array_lines(icache.LRU_head, icache.n_sets);
-  printf("  LRU_tail:  ");
-  print_array_lines(icache.LRU_tail, icache.n_sets);
+  printf("  mask offset:  %d\n", sim->icache.index_mask_offset);
   printf("  set_contents:  ");
-  print_array_ints(icache.set_contents, icache.n_sets);
-  if (cache_split) {
+  print_array_ints(sim->icache.set_contents, sim->icache.n_sets);
+  for (int i = 0; i < sim->icache.n_sets; i++) {
+    printf("  set %d:  ", i);
+    print_array_lines(&sim->icache, i);
+  }
+  if (sim->cache_split) {
     printf(" DATA CACHE\n");
-    printf("  size:  %d\n", dcache.size);
-    printf("  associativity:  %d\n", dcache.associativity);
-    printf("  sets:  %d\n", dcache.n_sets);
+    printf("  size:  %d\n", sim->dcache.size);
+    printf("  associativity:  %d\n", sim->dcache.associativity);
+    printf("  sets:  %d\n", sim->dcache.n_sets);
     printf("  mask:  ");
-    print_binary_representation(dcache.index_mask);
+    print_binary_representation(sim->dcache.index_mask);
     printf("\n");
-    printf("  mask offset:  %d\n", dcache.index_mask_offset);
-    printf("  LRU_head:  ");
-    print_array_lines(dcache.LRU_head, dcache.n_sets);
-    printf("  LRU_tail:  ");
-    print_array_lines(dcache.LRU_tail, dcache.n_sets);
+    printf("  mask offset:  %d\n", sim->dcache.index_mask_offset);
     printf("  set_contents:  ");
-    print_array_ints(dcache.set_contents, dcache.n_sets);
+    print_array_ints(sim->dcache.set_contents, sim->dcache.n_sets);
+    for (int i = 0; i < sim->dcache.n_sets; i++) {
+      printf("  set %d:  ", i);
+      print_array_lines(&sim->dcache, i);
+    }
   }
   printf("\n*** END OF CACHE STATUS ***\n\n");
 }
 
-void countAccesses(unsigned number) {
+void countAccesses(Pcache_sim sim, unsigned number) {
   if (number < 2) {
-    cache_stat_data.accesses++;
+    sim->cache_stat_data.accesses++;
   } else {
-    cache_stat_inst.accesses++;
+    sim->cache_stat_inst.accesses++;
   }
 }
 
 /* helper function to get line index */
-int getLineIndex(addr, access_type)
-  unsigned addr, access_type;
-{
-  if (access_type < 2) {
-    return (addr & ptr_dcache->index_mask) >> ptr_dcache->index_mask_offset;
-  } else {
-    return (addr & ptr_icache->index_mask) >> ptr_icache->index_mask_offset;
-  }
+int getLineIndex(Pcache ptr_cache, sim_addr addr) {
+  return (addr & ptr_cache->index_mask) >> ptr_cache->index_mask_offset;
 }
 
 /* helper function to get tag from memory address */
-unsigned getTag(addr, nLines)
-  unsigned addr, nLines;
-{
-  int offset = LOG2(nLines) + LOG2(words_per_block * WORD_SIZE);
+sim_addr getTag(Pcache ptr_cache, sim_addr addr) {
   // printf("Tag: ");
-  // print_binary_representation(addr >> offset);
+  // print_binary_representation(addr >> ptr_cache->tag_shift);
   // printf("...\n");
-  return addr >> offset;
+  return addr >> ptr_cache->tag_shift;
 }
 
-/* helper function to check for hits */
-int isHit(addr, access_type, index)
-  unsigned addr, access_type;
-  int index;
-{
-  Pcache_line element;
-  unsigned tag;
-  if (access_type < 2) {
-    element = ptr_dcache->LRU_head[index];
-    tag = getTag(addr, ptr_dcache->n_sets);
-  } else {
-    element = ptr_icache->LRU_head[index];
-    tag = getTag(addr, ptr_icache->n_sets);
+/* helper function to read the tag of line pos (set * associativity + way) */
+sim_addr line_tag(Pcache ptr_cache, int pos) {
+  if (ptr_cache->tag_bytes == sizeof(unsigned)) {
+    return ((unsigned *)ptr_cache->tags)[pos];
+  }
+  return ((sim_addr *)ptr_cache->tags)[pos];
+}
+
+/* helper function to copy the 32-bit tags of a cache into a new
+ * array of 64-bit tags, the first time a tag does not fit
+*/
+static void widen_tags(Pcache ptr_cache) {
+  int n = ptr_cache->n_sets * ptr_cache->associativity + CACHE_TAG_LANES;
+  unsigned *narrow = (unsigned *)ptr_cache->tags;
+  sim_addr *wide = (sim_addr *)malloc(sizeof(sim_addr) * n);
+
+  for (int i = 0; i < n; i++) {
+    wide[i] = narrow[i];
+  }
+  free(narrow);
+  ptr_cache->tags = wide;
+  ptr_cache->tag_bytes = sizeof(sim_addr);
+}
+
+#if CACHE_TAG_LANES > 1
+/* compares CACHE_TAG_LANES consecutive tags against tag
+ * and returns a bit mask with bit i set if tags[i] == tag
+*/
+static inline unsigned tag_match_mask(const unsigned *tags, unsigned tag) {
+#if defined(__AVX512F__)
+  return _mm512_cmpeq_epi32_mask(_mm512_loadu_si512((const void *)tags), _mm512_set1_epi32(tag));
+#elif defined(__AVX2__)
+  __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)tags), _mm256_set1_epi32(tag));
+  return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+#else
+  __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)tags), _mm_set1_epi32(tag));
+  return _mm_movemask_ps(_mm_castsi128_ps(eq));
+#endif
+}
+
+/* the same for CACHE_TAG_LANES / 2 tags of 64 bits; SSE2 has no
+ * 64-bit compare, so both halves of each lane must match
+*/
+static inline unsigned tag_match_mask64(const sim_addr *tags, sim_addr tag) {
+#if defined(__AVX512F__)
+  return _mm512_cmpeq_epi64_mask(_mm512_loadu_si512((const void *)tags), _mm512_set1_epi64(tag));
+#elif defined(__AVX2__)
+  __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)tags), _mm256_set1_epi64x(tag));
+  return _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+#else
+  __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)tags), _mm_set1_epi64x(tag));
+  eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_movemask_pd(_mm_castsi128_pd(eq));
+#endif
+}
+#endif
+
+/* helper function to find a tag inside a set
+ * returns the way (position inside the set) of the
+ * line holding the tag, or -1 if it is not cached.
+ * The tags of a set are compared CACHE_TAG_LANES at a
+ * time; lanes past the valid entries are masked off
+*/
+int get_line_way(Pcache ptr_cache, int set_index, sim_addr tag) {
+  int contents = ptr_cache->set_contents[set_index];
+  int way;
+
+  if (ptr_cache->tag_bytes == sizeof(sim_addr)) {
+    const sim_addr *tags = (const sim_addr *)ptr_cache->tags + set_index * ptr_cache->associativity;
+    if (CACHE_TAG_LANES == 1 || ptr_cache->associativity <= 2) {
+      for (way = 0; way < contents; way++) {
+        if (tags[way] == tag) {
+          return way;
+        }
+      }
+      return -1;
+    }
+#if CACHE_TAG_LANES > 1
+    for (way = 0; way < contents; way += CACHE_TAG_LANES / 2) {
+      unsigned matches = tag_match_mask64(tags + way, tag);
+      if (contents - way < CACHE_TAG_LANES / 2) {
+        matches &= (1u << (contents - way)) - 1;
+      }
+      if (matches) {
+        return way + __builtin_ctz(matches);
+      }
+    }
+#endif
+    return -1;
+  }
+
+  // una etiqueta que no cabe en 32 bits no puede estar en un
+  // arreglo que todavía no se ha ensanchado
+  const unsigned *tags = (const unsigned *)ptr_cache->tags + set_index * ptr_cache->associativity;
+  if (tag > 0xffffffffull) {
+    return -1;
+  }
+
+  // con pocas vías la comparación escalar es más barata
+  if (CACHE_TAG_LANES == 1 || ptr_cache->associativity <= 2) {
+    for (way = 0; way < contents; way++) {
+      if (tags[way] == tag) {
+        return way;
+      }
+    }
+    return -1;
+  }
+
+#if CACHE_TAG_LANES > 1
+  for (way = 0; way < contents; way += CACHE_TAG_LANES) {
+    unsigned matches = tag_match_mask(tags + way, (unsigned)tag);
+    if (contents - way < CACHE_TAG_LANES) {
+      matches &= (1u << (contents - way)) - 1;
+    }
+    if (matches) {
+      return way + __builtin_ctz(matches);
+    }
+  }
+#endif
+  return -1;
+}
+
+/* names of the replacement policies, indexed by REPLACE_* */
+static const char *replacement_names[REPLACE_POLICIES] = {
+  "LRU", "FIFO", "RANDOM", "PLRU", "SRRIP", "BRRIP", "LFU"
+};
+
+const char *replacement_name(int policy) {
+  return replacement_names[policy];
+}
+
+/* case-insensitive lookup of a policy name, -1 if unknown */
+int replacement_from_name(const char *name) {
+  for (int policy = 0; policy < REPLACE_POLICIES; policy++) {
+    const char *a = name, *b = replacement_names[policy];
+    while (*a && (*a == *b || *a == *b - 'A' + 'a')) {
+      a++;
+      b++;
+    }
+    if (!*a && !*b) {
+      return policy;
+    }
+  }
+  return -1;
+}
+
+/* xorshift64 step of the cache's random number generator */
+static unsigned long long replacement_random(Pcache ptr_cache) {
+  unsigned long long x = ptr_cache->rng_state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return ptr_cache->rng_state = x;
+}
+
+/* sets up the replacement state of a cache whose lines were
+ * just allocated. The seed makes Random and BRRIP reproducible
+*/
+void init_replacement(Pcache ptr_cache, int policy, unsigned seed) {
+  ptr_cache->policy = policy;
+  ptr_cache->lru_clock = 0;
+  // splitmix64 del seed, para que semillas cercanas no den
+  // secuencias parecidas y el estado nunca sea 0
+  ptr_cache->rng_state = seed + 0x9e3779b97f4a7c15ull;
+  ptr_cache->rng_state = (ptr_cache->rng_state ^ (ptr_cache->rng_state >> 30)) * 0xbf58476d1ce4e5b9ull;
+  ptr_cache->rng_state = (ptr_cache->rng_state ^ (ptr_cache->rng_state >> 27)) * 0x94d049bb133111ebull;
+  ptr_cache->rng_state ^= ptr_cache->rng_state >> 31;
+  if (ptr_cache->rng_state == 0) {
+    ptr_cache->rng_state = 1;
   }
-  while (element != NULL && tag != element->tag) {
-    element = element->LRU_next;
+  ptr_cache->set_bits = NULL;
+  if (policy == REPLACE_PLRU) {
+    ptr_cache->set_bits = (unsigned long long *)calloc(ptr_cache->n_sets, sizeof(unsigned long long));
   }
-  return element != NULL && tag == element->tag;
 }
 
-/* allocate an empty cache line */
-Pcache_line get_empty_line() {
-    Pcache_line ptr_new_line = (Pcache_line)malloc(sizeof(cache_line));
-    ptr_new_line->dirty = 0;
-    ptr_new_line->LRU_next = NULL;
-    ptr_new_line->LRU_prev = NULL;
-    return ptr_new_line;
+/* chooses the way to evict from a full set */
+int replacement_victim(Pcache ptr_cache, int set_index) {
+  int assoc = ptr_cache->associativity;
+  Pcache_line set = &ptr_cache->lines[set_index * assoc];
+  int victim = 0, way;
+
+  switch (ptr_cache->policy) {
+  case REPLACE_RANDOM:
+    return replacement_random(ptr_cache) % assoc;
+  case REPLACE_PLRU: {
+    // se baja por el árbol siguiendo los bits: cada nodo
+    // apunta a la mitad menos recientemente usada
+    unsigned long long bits = ptr_cache->set_bits[set_index];
+    int node = 1;
+    while (node < assoc) {
+      node = 2 * node + ((bits >> node) & 1);
+    }
+    return node - assoc;
+  }
+  case REPLACE_SRRIP:
+  case REPLACE_BRRIP: {
+    // la primera línea con el RRPV más alto; si no llega a
+    // RRIP_MAX se envejece todo el set lo que le falte
+    unsigned long long oldest = set[0].meta;
+    for (way = 1; way < assoc; way++) {
+      if (set[way].meta > oldest) {
+        oldest = set[way].meta;
+        victim = way;
+      }
+    }
+    if (oldest < RRIP_MAX) {
+      for (way = 0; way < assoc; way++) {
+        set[way].meta += RRIP_MAX - oldest;
+      }
+    }
+    return victim;
+  }
+  default: {
+    // LRU, FIFO y LFU: la línea con el valor más pequeño
+    unsigned long long oldest = set[0].meta;
+    for (way = 1; way < assoc; way++) {
+      if (set[way].meta < oldest) {
+        oldest = set[way].meta;
+        victim = way;
+      }
+    }
+    return victim;
+  }
+  }
 }
 
-/* checks cache associativity and inserts 
- * returns TRUE (1) if a replacemnt is done
- * FALSE (0) otherwise 
+/* marks the PLRU tree bits on the path to way so that
+ * every node points away from it
 */
-Pinsertion_response full_insert(unsigned addr, Pcache ptr_cache, int line_number) {
+static void plru_touch(Pcache ptr_cache, int set_index, int way) {
+  unsigned long long bits = ptr_cache->set_bits[set_index];
+  int node = way + ptr_cache->associativity;
+
+  while (node > 1) {
+    int parent = node >> 1;
+    if (node & 1) {
+      bits &= ~(1ull << parent);
+    } else {
+      bits |= 1ull << parent;
+    }
+    node = parent;
+  }
+  ptr_cache->set_bits[set_index] = bits;
+}
+
+/* replacement state of a line just placed in way */
+void replacement_fill(Pcache ptr_cache, int set_index, int way) {
+  Pcache_line line = &ptr_cache->lines[set_index * ptr_cache->associativity + way];
+
+  switch (ptr_cache->policy) {
+  case REPLACE_LRU:
+  case REPLACE_FIFO:
+    line->meta = ++ptr_cache->lru_clock;
+    break;
+  case REPLACE_PLRU:
+    plru_touch(ptr_cache, set_index, way);
+    break;
+  case REPLACE_SRRIP:
+    line->meta = RRIP_MAX - 1;
+    break;
+  case REPLACE_BRRIP:
+    line->meta = (replacement_random(ptr_cache) % BRRIP_EPSILON) ? RRIP_MAX : RRIP_MAX - 1;
+    break;
+  case REPLACE_LFU:
+    line->meta = 1;
+    break;
+  }
+}
+
+/* replacement state of a line that hit */
+void replacement_touch(Pcache ptr_cache, int set_index, int way) {
+  Pcache_line line = &ptr_cache->lines[set_index * ptr_cache->associativity + way];
 
-  // allocate a new response to return at the end of the function
-  Pinsertion_response ptr_response = get_new_insertion_response();
+  switch (ptr_cache->policy) {
+  case REPLACE_LRU:
+    line->meta = ++ptr_cache->lru_clock;
+    break;
+  case REPLACE_PLRU:
+    plru_touch(ptr_cache, set_index, way);
+    break;
+  case REPLACE_SRRIP:
+  case REPLACE_BRRIP:
+    line->meta = 0;
+    break;
+  case REPLACE_LFU:
+    line->meta++;
+    break;
+  }
+}
 
-  // get a new line that will be inserted in cache
-  Pcache_line ptr_new_line = get_empty_line();
+/* checks cache associativity and inserts the tag
+ * into the set, evicting the line chosen by the
+ * replacement policy if the set is already full. The response tells
+ * whether a replacement happened, the dirty bit of the
+ * evicted line and the way where the tag was placed
+*/
+insertion_response full_insert(Pcache ptr_cache, int set_index, sim_addr tag) {
+  insertion_response response = { .replacement = FALSE };
+  Pcache_line set = &ptr_cache->lines[set_index * ptr_cache->associativity];
+  int base = set_index * ptr_cache->associativity;
 
-  // add tag to new line for cache
-  ptr_new_line->tag = getTag(addr, ptr_cache->n_sets);
-  
   // enter if there is no more room for the new line
   // a line needs to be removed
-  if (ptr_cache->set_contents[line_number] >= ptr_cache->associativity) {
-    Pcache_line ptr_line_delete = ptr_cache->LRU_tail[line_number];
+  if (ptr_cache->set_contents[set_index] >= ptr_cache->associativity) {
+    // the replacement policy chooses the victim
+    int victim = replacement_victim(ptr_cache, set_index);
     // we indicate that a replacement has occured as a product of the insertion
-    ptr_response->replacement = TRUE;
-    // we set the response's dirty bit to that of the evicted line (LRU)
-    ptr_response->dirty_bit = ptr_line_delete->dirty;
-    // we delete the line
-    delete(&ptr_cache->LRU_head[line_number], &ptr_cache->LRU_tail[line_number], ptr_line_delete); 
+    response.replacement = TRUE;
+    // we set the response's dirty bit to that of the evicted line
+    response.dirty_bit = set[victim].dirty;
+    response.way = victim;
+    response.victim_tag = line_tag(ptr_cache, base + victim);
+    response.victim_prefetched = set[victim].prefetched;
   } else {
-    ptr_cache->set_contents[line_number] += 1;
+    // the set still has room, lines are filled in order
+    response.way = ptr_cache->set_contents[set_index];
+    ptr_cache->set_contents[set_index] += 1;
   }
 
-  // insert the line asked
-  insert(&ptr_cache->LRU_head[line_number], &ptr_cache->LRU_tail[line_number], ptr_new_line);
-  return ptr_response;
+  // overwrite the chosen way with the line asked
+  if (ptr_cache->tag_bytes == sizeof(unsigned) && tag > 0xffffffffull) {
+    widen_tags(ptr_cache);
+  }
+  if (ptr_cache->tag_bytes == sizeof(unsigned)) {
+    ((unsigned *)ptr_cache->tags)[base + response.way] = (unsigned)tag;
+  } else {
+    ((sim_addr *)ptr_cache->tags)[base + response.way] = tag;
+  }
+  set[response.way].dirty = 0;
+  set[response.way].prefetched = 0;
+  replacement_fill(ptr_cache, set_index, response.way);
+  return response;
 }
 
-/* get a pointer to a new Pinsertion_response struct */
-Pinsertion_response get_new_insertion_response() {
-  Pinsertion_response ptr_response = (Pinsertion_response)malloc(sizeof(insertion_response));
-  ptr_response->dirty_bit = 0;
-  ptr_response->replacement = 0;
-  return ptr_response;
-}
+/* removes the line in way from its set; the last valid line
+ * of the set takes its place so that sets stay filled in order
+*/
+void invalidate_line(Pcache ptr_cache, int set_index, int way) {
+  int base = set_index * ptr_cache->associativity;
+  int last = --ptr_cache->set_contents[set_index];
 
-/* get line from set with correct tag and returns a Pcache_line */
-Pcache_line get_referenced_line(Pcache ptr_cache, unsigned addr, int set_index) {
-  Pcache_line element = ptr_cache->LRU_head[set_index];
-  unsigned tag = getTag(addr, ptr_cache->n_sets);
-  while (element != NULL && tag != element->tag) {
-    element = element->LRU_next;
-  }
-  if (element == NULL) {
-    printf("=== Error: Line NOT found in cache set ===");
-    abort();
+  if (way != last) {
+    if (ptr_cache->tag_bytes == sizeof(unsigned)) {
+      ((unsigned *)ptr_cache->tags)[base + way] = ((unsigned *)ptr_cache->tags)[base + last];
+    } else {
+      ((sim_addr *)ptr_cache->tags)[base + way] = ((sim_addr *)ptr_cache->tags)[base + last];
+    }
+    ptr_cache->lines[base + way] = ptr_cache->lines[base + last];
   }
-  return element;
 }
 
-/* remove cache line and reinsert it at LRU head */
-void reinsert_at_head(Pcache ptr_cache, unsigned addr, int set_index) {
-  Pcache_line line_used = get_referenced_line(ptr_cache, addr, set_index);
-  delete(&ptr_cache->LRU_head[set_index], &ptr_cache->LRU_tail[set_index], line_used);
-  insert(&ptr_cache->LRU_head[set_index], &ptr_cache->LRU_tail[set_index], line_used);
+/* update the replacement state of a line that was referenced */
+void touch_line(Pcache ptr_cache, int set_index, int way) {
+  replacement_touch(ptr_cache, set_index, way);
 }
 
-/* free cache LRU_head, LRU_tail, set_contents */
+/* free cache lines and set_contents */
 void free_cache_resources(Pcache ptr_cache) {
-  free(ptr_cache->LRU_head);
-  free(ptr_cache->LRU_tail);
+  free(ptr_cache->lines);
+  free(ptr_cache->set_bits);
+  free(ptr_cache->tags);
   free(ptr_cache->set_contents);
+  free(ptr_cache->prefetcher);
+  free_shadow(ptr_cache->shadow);
+  free_victim(ptr_cache->victim);
 }
 
-void free_structure(cache *data) {
+/* write back every dirty line still in cache and empty its sets */
+void free_structure(Pcache_sim sim, cache *data) {
   for (int i = 0; i < data->n_sets; i++) {
     // printf("Flushig cache set no. %d...\n", i + 1);
-    Pcache_line ptr_next_element = data->LRU_head[i];
-    Pcache_line ptr_actual_element;
+    Pcache_line set = &data->lines[i * data->associativity];
+    if (data->heat) {
+      heatmap_flush_set(sim, data, i);
+    }
     for (int j = 0; j < data->set_contents[i]; j++) {
       // printf("  flushing line no. %d...\n", j + 1);
-      ptr_actual_element = ptr_next_element;
-      cache_stat_inst.copies_back += ptr_actual_element->dirty * words_per_block;
-      ptr_next_element = ptr_actual_element->LRU_next;
-      free(ptr_actual_element);
+      COUNT_COPY_BACK(&sim->cache_stat_inst, set[j].dirty * sim->words_per_block);
+      // con L2 la línea sucia se escribe en el siguiente nivel
+      if (set[j].dirty && sim->n_lower) {
+        lower_writeback(sim, 0, block_address(data, i, line_tag(data, i * data->associativity + j)));
+      }
     }
+    data->set_contents[i] = 0;
   }
-}
\ No newline at end of file
+}
+
+/* free the caches of a simulator and the simulator itself */
+void free_cache_sim(Pcache_sim sim) {
+  if (sim->initialized) {
+    free_cache_resources(&sim->icache);
+    if (sim->cache_split) {
+      free_cache_resources(&sim->dcache);
+    }
+    for (int k = 0; k < sim->n_lower; k++) {
+      free_cache_resources(&sim->lower[k]);
+    }
+    free_heatmap(sim);
+    free_write_buffer(sim->wbuf);
+  }
+#ifdef _WIN32
+  _aligned_free(sim);
+#else
+  free(sim);
+#endif
+}
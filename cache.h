@@ -3,6 +3,10 @@
  * cache.h
  */
 
+#include "cachesim.h"
+#include "profile.h"
+#include "blockmap.h"
+
 #define TRUE 1
 #define FALSE 0
 
@@ -14,49 +18,235 @@
 #define DEFAULT_CACHE_ASSOC 1
 #define DEFAULT_CACHE_WRITEBACK TRUE
 #define DEFAULT_CACHE_WRITEALLOC TRUE
-#define DEFAULT_ADDRESS_SIZE 32
+#define DEFAULT_ADDRESS_SIZE 64
 #define DEFAULT_DEBUG FALSE
+#define DEFAULT_REPLACEMENT REPLACE_LRU
+#define DEFAULT_SEED 1
+
+/* valor máximo del RRPV de SRRIP/BRRIP (2 bits) */
+#define RRIP_MAX 3
+/* BRRIP inserta con RRIP_MAX - 1 una de cada BRRIP_EPSILON veces */
+#define BRRIP_EPSILON 32
+/* PLRU guarda el árbol de un set en un entero de 64 bits */
+#define PLRU_MAX_ASSOC 64
+
+/* niveles que puede haber debajo de L1 (L2 y L3) */
+#define MAX_LOWER_LEVELS 2
+#define DEFAULT_LOWER_ASSOC 8
+#define DEFAULT_INCLUSION INCLUSION_NONE
+
+/* prefetchers de L1 (ver prefetch.c) */
+#define DEFAULT_PREFETCHER PREFETCH_NONE
+#define DEFAULT_PREFETCH_DEGREE 1   /* blocks asked per trigger */
+#define DEFAULT_PREFETCH_LATENCY 8  /* references a prefetch takes to arrive */
+#define PREFETCH_REGION_BITS 12     /* stride prefetcher tracks 4 KB regions */
+#define PREFETCH_STRIDE_ENTRIES 64  /* regions tracked at once */
+#define PREFETCH_STREAMS 4          /* stream buffers per cache */
+#define PREFETCH_STREAM_DEPTH 4     /* blocks per stream buffer */
+#define PREFETCH_FILTER 1024        /* blocks evicted by prefetches remembered */
+
+/* clasificación de fallos y victim cache (ver classify.c y victim.c) */
+#define DEFAULT_CLASSIFY FALSE
+#define DEFAULT_VICTIM_ENTRIES 0     /* no victim cache */
+#define SHADOW_INITIAL_BLOCKS 4096   /* initial size of the seen-block map */
+
+/* mapa de calor por set y por región (ver heatmap.c) */
+#define DEFAULT_HEATMAP 0            /* off */
+#define HEATMAP_REGION_SLOTS 4096    /* slots of the region table, power of two */
+#define HEATMAP_REGION_MAX (HEATMAP_REGION_SLOTS / 4 * 3) /* regions tracked at once */
+
+/* buffer de escritura de write through (ver writebuf.c) */
+#define DEFAULT_WRITE_BUFFER 0       /* none: every store is one word of traffic */
+#define DEFAULT_WB_DRAIN WBUF_DRAIN_EAGER
+#define DEFAULT_WB_RATE 4            /* references to write one entry */
+
+/* referencias que perform_access_batch() prepara a la vez */
+#define ACCESS_BATCH 1024
+
+/* línea de cache del procesador que corre el simulador; los
+ * contadores de cada simulador empiezan en una propia */
+#define SIM_CACHE_LINE 64
 
-/* constants for settting cache parameters */
-#define CACHE_PARAM_BLOCK_SIZE 0
-#define CACHE_PARAM_USIZE 1
-#define CACHE_PARAM_ISIZE 2
-#define CACHE_PARAM_DSIZE 3
-#define CACHE_PARAM_ASSOC 4
-#define CACHE_PARAM_WRITEBACK 5
-#define CACHE_PARAM_WRITETHROUGH 6
-#define CACHE_PARAM_WRITEALLOC 7
-#define CACHE_PARAM_NOWRITEALLOC 8
-#define CACHE_PARAM_DEBUG 9
+/* cuentan un fetch o un copy back de words palabras, en palabras
+ * y en bytes */
+#define COUNT_DEMAND_FETCH(stat, words) \
+  ((stat)->demand_fetches += (words), (stat)->demand_bytes += (long long)(words) * WORD_SIZE)
+#define COUNT_COPY_BACK(stat, words) \
+  ((stat)->copies_back += (words), (stat)->copies_back_bytes += (long long)(words) * WORD_SIZE)
+
+/* etiquetas de 32 bits que get_line_way() compara en una sola
+ * instrucción (de 64 bits, la mitad); depende de las extensiones
+ * con las que se compile (-march) */
+#if defined(__AVX512F__)
+#define CACHE_TAG_LANES 16
+#elif defined(__AVX2__)
+#define CACHE_TAG_LANES 8
+#elif defined(__SSE2__)
+#define CACHE_TAG_LANES 4
+#else
+#define CACHE_TAG_LANES 1
+#endif
 
 /* structure definitions */
 // definición de la estructura de una línea de cache
-// además de una etiqueta y un dirty bit contiene
-// dos apuntadores a líneas de cache ya que se
-// implementa como una lista doblemente ligada
-// útil cuando se use para cache con asociatividad
+// además de un dirty bit contiene el dato que la política
+// de reemplazo guarda por línea, sin necesidad de mantener
+// una lista ligada:
+//   LRU:   marca de tiempo de su último uso
+//   FIFO:  marca de tiempo de su llegada al set
+//   LFU:   número de referencias desde que llegó
+//   RRIP:  re-reference prediction value (0..RRIP_MAX)
+// Random y PLRU no lo usan. La etiqueta se guarda aparte
+// (ver cache)
 typedef struct cache_line_
 {
-  unsigned tag;
-  int dirty;
-
-  struct cache_line_ *LRU_next;
-  struct cache_line_ *LRU_prev;
+  unsigned char dirty;
+  unsigned char prefetched; /* brought by the prefetcher, not yet used */
+  unsigned prefetch_time;   /* reference number of the prefetch */
+  unsigned long long meta;  /* per-line replacement state */
 } cache_line, *Pcache_line;
 
+// estado del prefetcher de un cache L1. El de stride sigue, por
+// región de 4 KB, el último bloque referenciado y la diferencia
+// entre los dos últimos; los stream buffers guardan bloques
+// consecutivos fuera del cache. filter recuerda (número de bloque
+// + 1) los bloques que un prefetch sacó del cache para detectar
+// los fallos que causó
+typedef struct stride_entry_
+{
+  sim_addr region;     /* address >> PREFETCH_REGION_BITS */
+  sim_addr last_block; /* last block number referenced */
+  int stride;          /* last difference in blocks */
+  int confidence;      /* times the stride repeated, up to 3 */
+} stride_entry;
+
+typedef struct stream_buffer_
+{
+  int count;                                   /* valid blocks, from 0 */
+  sim_addr blocks[PREFETCH_STREAM_DEPTH];      /* block numbers */
+  unsigned char dirty[PREFETCH_STREAM_DEPTH];  /* came dirty from an exclusive L2 */
+  unsigned times[PREFETCH_STREAM_DEPTH];       /* reference number of each prefetch */
+  unsigned long long last_use;                 /* LRU among buffers */
+} stream_buffer;
+
+typedef struct prefetcher_
+{
+  int kind;          /* PREFETCH_* */
+  int degree;
+  stride_entry strides[PREFETCH_STRIDE_ENTRIES];
+  stream_buffer streams[PREFETCH_STREAMS];
+  unsigned long long stream_clock;
+  sim_addr filter[PREFETCH_FILTER];
+} prefetcher, *Pprefetcher;
+
+// cache sombra totalmente asociativo LRU con la capacidad de un L1,
+// para clasificar sus fallos. map tiene todos los bloques vistos:
+// node es -1 si el bloque se vio pero no está en la sombra y k + 1
+// si ocupa el nodo k de la lista LRU (prev/next, -1 al final)
+typedef struct shadow_entry_
+{
+  sim_addr key;   /* block number + 1, see block_map */
+  int node;       /* see above */
+} shadow_entry;
+
+typedef struct shadow_cache_
+{
+  int capacity;       /* blocks, the lines of the L1 cache */
+  int used;           /* nodes in the list */
+  int head, tail;     /* most and least recently used node */
+  int *prev, *next;   /* LRU list over the nodes */
+  sim_addr *blocks;   /* block held by each node */
+  block_map map;      /* every block seen, of shadow_entry */
+} shadow_cache, *Pshadow_cache;
+
+// victim cache totalmente asociativo al lado de un L1: recibe las
+// líneas que L1 reemplaza y las regresa en un fallo. Es LRU con
+// las marcas de stamp, como los sets de los caches
+typedef struct victim_cache_
+{
+  int entries;              /* capacity in blocks */
+  int count;                /* valid entries, from 0 */
+  sim_addr *blocks;         /* block numbers */
+  unsigned char *dirty;
+  unsigned long long *stamp; /* last use */
+  unsigned long long clock;
+} victim_cache, *Pvictim_cache;
+
+// contadores de un set de L1 para el mapa de calor
+typedef struct set_heat_
+{
+  long long accesses;
+  long long misses;
+  long long evictions;   /* valid lines replaced by a miss */
+  long long copies_back; /* words written back, including the final flush */
+  int occupancy;         /* valid lines at the final flush */
+} set_heat, *Pset_heat;
+
+// contadores de una región de memoria (páginas de 2^bits bytes).
+// La tabla es de direccionamiento abierto y tamaño fijo: tiene
+// HEATMAP_REGION_SLOTS lugares y guarda a lo más
+// HEATMAP_REGION_MAX regiones; las que ya no caben se suman en
+// other, así que la memoria no crece con la traza
+typedef struct region_heat_
+{
+  sim_addr key;          /* region number + 1, 0 if the slot is empty */
+  long long accesses;
+  long long misses;
+  long long stores;      /* data writes, the traffic of write through */
+  long long evictions;   /* blocks of the region replaced in L1 */
+  long long copies_back; /* words of the region written back */
+} region_heat, *Pregion_heat;
+
+typedef struct region_map_
+{
+  int bits;              /* log2 of the region size in bytes */
+  int used;              /* regions in slots */
+  region_heat slots[HEATMAP_REGION_SLOTS];
+  region_heat other;     /* everything that did not fit */
+} region_map, *Pregion_map;
+
+// buffer de escritura entre L1 y memoria: una cola FIFO de
+// bloques, cada uno con la máscara de las palabras escritas
+// (mask_words enteros de 64 bits por entrada). La memoria escribe
+// una entrada cada wbuf_rate referencias; busy_since es la
+// referencia en la que empezó a escribir la más antigua
+typedef struct write_buffer_
+{
+  int count;                 /* valid entries, oldest first */
+  int mask_words;            /* 64-bit words of mask per entry */
+  sim_addr *blocks;          /* block numbers */
+  unsigned long long *masks; /* words written of each block */
+  long long busy_since;
+} write_buffer, *Pwrite_buffer;
+
 // definción de estructura que modela a la memoria cache
 // contiene tamaño, asociatividad, número de sets,
 // máscara de índice y máscara de offset. Estos
 // son los parámetros que se inicializan desde la función
 // init_cache() del main.c.
-// El apuntador *LRU_head sirve de referencia al arreglo
-// de cabezas de cada lista (banco) de líneas de cache.
-// El apuntador *LRU_tail sirve de referencia al arreglo
-// de finalización de cada lista (banco) del cache. Es
-// solamente necesario para implementar LRU de forma rápida.
+// El apuntador *lines hace referencia a un solo arreglo
+// contiguo de n_sets * associativity líneas que se reserva
+// en init_cache(); el set i ocupa las posiciones
+// [i * associativity, (i + 1) * associativity). De esta forma
+// ningún acceso al cache necesita pedir memoria al sistema.
+// Las etiquetas viven en un arreglo paralelo *tags con el
+// mismo orden, así las de un set quedan contiguas y se pueden
+// comparar todas a la vez con instrucciones SIMD. Lleva
+// CACHE_TAG_LANES posiciones extra al final para que la
+// lectura vectorial del último set no se salga del arreglo.
+// Cada etiqueta ocupa tag_bytes: el arreglo empieza con 4, que
+// bastan para cualquier traza de 32 bits y para los caches
+// grandes de una de 48 (la etiqueta no guarda los bits de
+// índice ni de offset), y se ensancha a 8 la primera vez que
+// llega una etiqueta que no cabe (ver widen_tags()).
 // contents sirve para llevar un conteo de la cardinalidad
 // de cada banco para asegurarse que ninguno exceda la
 // asociatividad expecificada. Es un arreglo de enteros
+// lru_clock es el reloj con el que LRU y FIFO marcan las
+// líneas: la línea con la marca más pequeña de un set es
+// la menos recientemente usada (o la más antigua). PLRU
+// guarda los bits de su árbol en set_bits, uno por set, y
+// Random y BRRIP sacan sus números de rng_state.
 typedef struct cache_
 {
   int size;              /* cache size */
@@ -64,60 +254,135 @@ typedef struct cache_
   int n_sets;            /* number of cache sets */
   unsigned index_mask;   /* mask to find cache index */
   int index_mask_offset; /* number of zero bits in mask */
-  Pcache_line *LRU_head; /* head of LRU list for each set */
-  Pcache_line *LRU_tail; /* tail of LRU list for each set */
+  int tag_shift;         /* offset bits + index bits */
+  Pcache_line lines;     /* n_sets * associativity lines, set by set */
+  void *tags;            /* tag of each line, same layout as lines */
+  int tag_bytes;         /* 4 (unsigned) or 8 (sim_addr) per tag */
   int *set_contents;     /* number of valid entries in set */
+  int policy;            /* REPLACE_* */
+  unsigned long long lru_clock; /* last timestamp handed out */
+  unsigned long long *set_bits; /* PLRU tree of each set, NULL otherwise */
+  unsigned long long rng_state; /* xorshift state of Random and BRRIP */
+  Pprefetcher prefetcher;       /* L1 prefetcher, NULL if none */
+  Pshadow_cache shadow;         /* 3C classification of L1, NULL if off */
+  Pvictim_cache victim;         /* L1 victim cache, NULL if none */
+  Pset_heat heat;               /* per-set counters of L1, NULL if off */
   // int contents;			/* number of valid entries in cache (no le veo la utilidad) */
 } cache, *Pcache;
 
-typedef struct cache_stat_
+// definición de un simulador completo: los parámetros que
+// se configuran con set_cache_param(), los caches de
+// instrucciones y datos y sus estadísticas. Antes eran
+// variables globales de cache.c; al agruparlas aquí se
+// pueden simular varias configuraciones en un solo proceso.
+// Fuera de la biblioteca es un tipo opaco (ver cachesim.h).
+struct cache_sim_
 {
-  int accesses;       /* number of memory references */
-  int misses;         /* number of cache misses */
-  int replacements;   /* number of misses that cause replacments */
-  int demand_fetches; /* number of fetches */
-  int copies_back;    /* number of write backs */
-} cache_stat, *Pcache_stat;
+  /* cache configuration parameters */
+  int cache_split;
+  int cache_usize;
+  int cache_isize;
+  int cache_dsize;
+  int cache_block_size;
+  int words_per_block;
+  int cache_assoc;
+  int cache_writeback;
+  int cache_writealloc;
+  int address_size;
+  int debug;
+  int replacement;
+  unsigned seed;
+  int lower_size[MAX_LOWER_LEVELS];  /* L2, L3 sizes, 0 if absent */
+  int lower_assoc[MAX_LOWER_LEVELS]; /* L2, L3 associativities */
+  int inclusion;                     /* INCLUSION_* between levels */
+  int prefetch_kind;                 /* PREFETCH_* of the L1 caches */
+  int prefetch_degree;
+  int prefetch_latency;
+  int classify;                      /* TRUE to split L1 misses into the 3C */
+  int victim_entries;                /* victim cache of each L1, 0 if none */
+  int heatmap;                       /* log2 of the heat map regions, 0 if off */
+  int wbuf_entries;                  /* write buffer of write through, 0 if none */
+  int wbuf_drain;                    /* WBUF_DRAIN_* */
+  int wbuf_rate;                     /* references to write one entry downstream */
+  long long warmup;                  /* references left before counting statistics */
+  long long clock_base;              /* references simulated before reset_stats() */
+
+  /* cache model data structures */
+  Pcache ptr_icache;          /* apuntador a cache de instrucciones */
+  Pcache ptr_dcache;          /* apuntador a cache de datos */
+  cache icache;               /* cache de instrucciones, o cache unico en caso unificado */
+  cache dcache;               /* cache de datos */
+  int initialized;            /* TRUE once init_cache() has run */
+
+  /* niveles unificados debajo de L1 (ver hierarchy.c) */
+  int n_lower;                             /* number of levels below L1 */
+  cache lower[MAX_LOWER_LEVELS];           /* L2, L3 */
+  int flushing;               /* TRUE while flush() empties the levels */
+  Pregion_map regions;        /* heat map by region, NULL if off */
+  Pwrite_buffer wbuf;         /* write buffer, NULL if none */
+
+  // contadores: cada hilo de -j y de --shards simula con su propio
+  // simulador y se suman al final (sim_merge_stats()). Van juntos
+  // al final y empiezan en una línea propia, para que los de dos
+  // simuladores vecinos en el heap no compartan línea de cache
+  _Alignas(SIM_CACHE_LINE)
+  cache_stat cache_stat_inst; /* estadísticas del cache de instrucciones */
+  cache_stat cache_stat_data; /* estadísticas del cache de datos */
+  cache_stat lower_stat[MAX_LOWER_LEVELS]; /* L2, L3 statistics */
+  prefetch_stat prefetch_stats; /* L1 prefetcher, instructions and data */
+  miss_class class_inst;      /* instruction misses by cause */
+  miss_class class_data;      /* data misses by cause */
+  victim_stat victim_stats;   /* L1 victim caches */
+  write_buffer_stat wbuf_stats; /* write buffer */
+#if defined(SIM_PROFILE)
+  sim_profile profile;        /* time of each phase of apply_access() */
+#endif
+};
 
 typedef struct insertion_response_
 {
   int replacement; /* True if last insertion produce a replacement */
   int dirty_bit;   /* Value of dirty bit of line replaced */
+  int way;         /* Position of the inserted line inside its set */
+  sim_addr victim_tag; /* Tag of the line replaced */
+  int victim_prefetched; /* True if it was prefetched and never used */
 } insertion_response, *Pinsertion_response;
 
 /* function prototypes */
+Pcache_sim get_new_cache_sim();
 void set_cache_param();
-void init_cache();
+int init_cache();
 void perform_access();
+void apply_access();
+void perform_access_batch();
 void flush();
-void delete ();
-void insert();
 void dump_settings();
 void print_stats();
-int get_index_mask();
+int log2_int();
+int check_cache_config();
+int check_shard_config();
+void set_cache_geometry();
+void init_cache_level();
+sim_addr block_address();
+void invalidate_line();
 void initialize_zeros();
-void initialize_null();
 void init_cache_stats();
-void emptyPointer();
-void emptyCache();
-void emptyCacheLine();
-void emptyInt();
-void binary_representation();
+void reset_stats();
 void print_binary_representation();
 void print_array_ints();
 void print_array_lines();
 void print_cache_status();
 void countAccesses();
 int getLineIndex();
-unsigned getTag();
-int isHit();
-Pcache_line get_empty_line();
-Pinsertion_response full_insert();
-Pinsertion_response get_new_insertion_response();
-Pcache_line get_referenced_line();
-void reinsert_at_head();
+sim_addr getTag();
+sim_addr line_tag();
+void init_replacement();
+int replacement_victim();
+void replacement_fill();
+void replacement_touch();
+int get_line_way();
+insertion_response full_insert();
+void touch_line();
 void free_cache_resources();
 void free_structure();
-
-/* macros */
-#define LOG2(x) ((int)rint((log((double)(x))) / (log(2.0))))
+void free_cache_sim();
@@ -0,0 +1,231 @@
+/*
+ * cachesim.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "cache.h"
+
+/************************************************************/
+// implementación de la interfaz pública de cachesim.h sobre
+// las funciones de cache.c. Los caches se reservan hasta el
+// primer acceso para que la configuración se pueda cambiar
+// libremente después de sim_create()
+Pcache_sim sim_create(void)
+{
+  return get_new_cache_sim();
+}
+
+int sim_configure(Pcache_sim sim, int param, int value)
+{
+  if (sim->initialized || param < CACHE_PARAM_BLOCK_SIZE || param > CACHE_PARAM_WB_RATE)
+    return (-1);
+  if (param == CACHE_PARAM_PREFETCHER && (value < 0 || value >= PREFETCHERS))
+    return (-1);
+  if (param == CACHE_PARAM_VICTIM_ENTRIES && value < 0)
+    return (-1);
+  if (param == CACHE_PARAM_HEATMAP && (value < 0 || value > 63))
+    return (-1);
+  if (param == CACHE_PARAM_WRITE_BUFFER && value < 0)
+    return (-1);
+  if (param == CACHE_PARAM_WB_DRAIN && (value < 0 || value >= WBUF_DRAINS))
+    return (-1);
+  if (param == CACHE_PARAM_WB_RATE && value < 1)
+    return (-1);
+  if (param == CACHE_PARAM_INCLUSION && (value < 0 || value >= INCLUSION_POLICIES))
+    return (-1);
+  if (param == CACHE_PARAM_REPLACEMENT && (value < 0 || value >= REPLACE_POLICIES))
+    return (-1);
+  set_cache_param(sim, param, value);
+  return (0);
+}
+
+int sim_check(Pcache_sim sim)
+{
+  return check_cache_config(sim);
+}
+
+int sim_access(Pcache_sim sim, sim_addr addr, unsigned access_type)
+{
+  if (access_type > TRACE_INST_LOAD)
+    return (-1);
+  if (!sim->initialized && init_cache(sim))
+    return (-1);
+  perform_access(sim, addr, access_type);
+  if (sim->warmup > 0 && --sim->warmup == 0)
+    reset_stats(sim);
+  return (0);
+}
+
+/* helper function with the body of sim_access_batch(), without the warm-up */
+static int access_batch(Pcache_sim sim, const unsigned char *types, const sim_addr *addrs, int n)
+{
+  int i, skipped = 0;
+
+  for (i = 0; i < n; i++)
+    skipped += types[i] > TRACE_INST_LOAD;
+  if (!skipped) {
+    perform_access_batch(sim, types, addrs, n);
+    return (0);
+  }
+
+  // con referencias no válidas se simula una por una
+  for (i = 0; i < n; i++)
+    if (types[i] <= TRACE_INST_LOAD)
+      perform_access(sim, addrs[i], types[i]);
+  return skipped;
+}
+
+// durante el calentamiento el bloque se corta en la referencia que
+// lo termina, para borrar ahí las estadísticas
+int sim_access_batch(Pcache_sim sim, const unsigned char *types, const sim_addr *addrs, int n)
+{
+  int w, skipped = 0;
+
+  if (!sim->initialized && init_cache(sim))
+    return (-1);
+  if (sim->warmup > 0) {
+    for (w = 0; w < n && sim->warmup > 0; w++)
+      sim->warmup -= types[w] <= TRACE_INST_LOAD;
+    skipped = access_batch(sim, types, addrs, w);
+    if (sim->warmup == 0)
+      reset_stats(sim);
+    types += w;
+    addrs += w;
+    n -= w;
+  }
+  return skipped + access_batch(sim, types, addrs, n);
+}
+
+void sim_warmup(Pcache_sim sim, long long refs)
+{
+  sim->warmup = refs > 0 ? refs : 0;
+}
+
+void sim_flush(Pcache_sim sim)
+{
+  if (sim->initialized)
+    flush(sim);
+}
+
+void sim_stats(Pcache_sim sim, Pcache_stat inst, Pcache_stat data)
+{
+  *inst = sim->cache_stat_inst;
+  *data = sim->cache_stat_data;
+}
+
+int sim_level_stats(Pcache_sim sim, int level, Pcache_stat stat)
+{
+  if (level < 2 || level - 2 >= sim->n_lower)
+    return (-1);
+  *stat = sim->lower_stat[level - 2];
+  return (0);
+}
+
+void sim_prefetch_stats(Pcache_sim sim, Pprefetch_stat stat)
+{
+  *stat = sim->prefetch_stats;
+}
+
+int sim_miss_classes(Pcache_sim sim, Pmiss_class inst, Pmiss_class data)
+{
+  if (!sim->classify)
+    return (-1);
+  *inst = sim->class_inst;
+  *data = sim->class_data;
+  return (0);
+}
+
+void sim_victim_stats(Pcache_sim sim, Pvictim_stat stat)
+{
+  *stat = sim->victim_stats;
+}
+
+int sim_write_buffer_stats(Pcache_sim sim, Pwrite_buffer_stat stat)
+{
+  if (!sim->wbuf)
+    return (-1);
+  *stat = sim->wbuf_stats;
+  return (0);
+}
+
+// el shard copia la configuración de sim antes de que se reserven
+// sus caches (sim todavía no tiene nada que compartir) y divide los
+// tamaños de todos los niveles entre el número de shards
+Pcache_sim sim_create_shard(Pcache_sim sim, int shard_shift, int shard_bits)
+{
+  Pcache_sim shard;
+  int k;
+
+  if (sim->initialized) {
+    printf("error:  a simulator can only be split before its first access\n");
+    return NULL;
+  }
+  if (check_shard_config(sim, shard_shift, shard_bits))
+    return NULL;
+  shard = get_new_cache_sim();
+  if (shard == NULL) {
+    printf("error:  out of memory for a shard\n");
+    return NULL;
+  }
+  *shard = *sim;
+  shard->cache_usize >>= shard_bits;
+  shard->cache_isize >>= shard_bits;
+  shard->cache_dsize >>= shard_bits;
+  for (k = 0; k < MAX_LOWER_LEVELS; k++)
+    shard->lower_size[k] >>= shard_bits;
+  shard->debug = FALSE;
+  shard->warmup = 0;
+  return shard;
+}
+
+// quita de la dirección los bits del shard: el índice del set en
+// el shard es el del cache completo sin esos bits y la etiqueta
+// queda igual
+sim_addr sim_shard_address(sim_addr addr, int shard_shift, int shard_bits)
+{
+  return ((addr >> (shard_shift + shard_bits)) << shard_shift) | (addr & ((1ull << shard_shift) - 1));
+}
+
+/* helper function to add the counters of one cache_stat to another */
+static void add_cache_stats(Pcache_stat to, Pcache_stat from)
+{
+  to->accesses += from->accesses;
+  to->misses += from->misses;
+  to->replacements += from->replacements;
+  to->demand_fetches += from->demand_fetches;
+  to->copies_back += from->copies_back;
+  to->demand_bytes += from->demand_bytes;
+  to->copies_back_bytes += from->copies_back_bytes;
+}
+
+void sim_merge_stats(Pcache_sim sim, Pcache_sim shard)
+{
+  int k;
+
+  add_cache_stats(&sim->cache_stat_inst, &shard->cache_stat_inst);
+  add_cache_stats(&sim->cache_stat_data, &shard->cache_stat_data);
+  sim->n_lower = shard->n_lower;
+  for (k = 0; k < shard->n_lower; k++)
+    add_cache_stats(&sim->lower_stat[k], &shard->lower_stat[k]);
+#if defined(SIM_PROFILE)
+  profile_merge(&sim->profile, &shard->profile);
+#endif
+}
+
+void sim_print_settings(Pcache_sim sim)
+{
+  dump_settings(sim);
+}
+
+void sim_print_stats(Pcache_sim sim)
+{
+  print_stats(sim);
+}
+
+void sim_destroy(Pcache_sim sim)
+{
+  free_cache_sim(sim);
+}
+/************************************************************/
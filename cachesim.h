@@ -0,0 +1,217 @@
+/*
+ * cachesim.h
+ *
+ * Interfaz pública del simulador como biblioteca. Cada
+ * simulador es un handle opaco con su propia configuración,
+ * caches y estadísticas, así que se pueden tener varios en
+ * un mismo proceso (y en hilos distintos, uno por hilo).
+ *
+ *   Pcache_sim sim = sim_create();
+ *   sim_configure(sim, CACHE_PARAM_ISIZE, 8192);
+ *   sim_configure(sim, CACHE_PARAM_DSIZE, 8192);
+ *   sim_access(sim, 0x408ed4, TRACE_INST_LOAD);
+ *   ...
+ *   sim_flush(sim);
+ *   sim_stats(sim, &inst, &data);
+ *   sim_destroy(sim);
+ */
+
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+/* constants for settting cache parameters */
+#define CACHE_PARAM_BLOCK_SIZE 0
+#define CACHE_PARAM_USIZE 1
+#define CACHE_PARAM_ISIZE 2
+#define CACHE_PARAM_DSIZE 3
+#define CACHE_PARAM_ASSOC 4
+#define CACHE_PARAM_WRITEBACK 5
+#define CACHE_PARAM_WRITETHROUGH 6
+#define CACHE_PARAM_WRITEALLOC 7
+#define CACHE_PARAM_NOWRITEALLOC 8
+#define CACHE_PARAM_DEBUG 9
+#define CACHE_PARAM_REPLACEMENT 10
+#define CACHE_PARAM_SEED 11
+#define CACHE_PARAM_L2_SIZE 12
+#define CACHE_PARAM_L2_ASSOC 13
+#define CACHE_PARAM_L3_SIZE 14
+#define CACHE_PARAM_L3_ASSOC 15
+#define CACHE_PARAM_INCLUSION 16
+#define CACHE_PARAM_PREFETCHER 17
+#define CACHE_PARAM_PREFETCH_DEGREE 18
+#define CACHE_PARAM_PREFETCH_LATENCY 19
+#define CACHE_PARAM_CLASSIFY 20        /* 1 splits L1 misses into the 3C */
+#define CACHE_PARAM_VICTIM_ENTRIES 21  /* victim cache beside each L1, 0 if none */
+#define CACHE_PARAM_HEATMAP 22         /* log2 of the heat map regions, 0 if off */
+#define CACHE_PARAM_WRITE_BUFFER 23    /* write buffer entries for write through, 0 if none */
+#define CACHE_PARAM_WB_DRAIN 24        /* WBUF_DRAIN_* */
+#define CACHE_PARAM_WB_RATE 25         /* references memory takes to write one entry */
+
+/* replacement policies, values of CACHE_PARAM_REPLACEMENT */
+#define REPLACE_LRU 0
+#define REPLACE_FIFO 1
+#define REPLACE_RANDOM 2
+#define REPLACE_PLRU 3
+#define REPLACE_SRRIP 4
+#define REPLACE_BRRIP 5
+#define REPLACE_LFU 6
+#define REPLACE_POLICIES 7
+
+/* inclusion policies of the L2/L3 levels, values of CACHE_PARAM_INCLUSION */
+#define INCLUSION_NONE 0      /* non-inclusive non-exclusive */
+#define INCLUSION_INCLUSIVE 1 /* lower levels hold everything above them */
+#define INCLUSION_EXCLUSIVE 2 /* a block lives in a single level */
+#define INCLUSION_POLICIES 3
+
+/* L1 prefetchers, values of CACHE_PARAM_PREFETCHER */
+#define PREFETCH_NONE 0
+#define PREFETCH_NEXTLINE 1 /* next blocks on every miss */
+#define PREFETCH_STRIDE 2   /* repeated address deltas inside a region */
+#define PREFETCH_STREAM 3   /* stream buffers beside the cache */
+#define PREFETCH_TAGGED 4   /* next blocks on a miss or a first hit to a prefetched block */
+#define PREFETCHERS 5
+
+/* drain policies of the write buffer, values of CACHE_PARAM_WB_DRAIN */
+#define WBUF_DRAIN_EAGER 0  /* memory writes entries whenever the buffer is not empty */
+#define WBUF_DRAIN_FULL 1   /* memory writes the oldest entry only when the buffer is full */
+#define WBUF_DRAINS 2
+
+/* access types, as in the *.trace files */
+#define TRACE_DATA_LOAD 0
+#define TRACE_DATA_STORE 1
+#define TRACE_INST_LOAD 2
+
+/* structure definitions */
+// dirección de memoria de una referencia; las trazas de x86-64 y
+// AArch64 usan direcciones virtuales de 48 y 57 bits
+typedef unsigned long long sim_addr;
+
+// contadores de 64 bits: demand_fetches crece en un bloque de
+// palabras por fallo y un int se desborda en unos cientos de
+// millones de referencias. El tráfico se cuenta en palabras,
+// como siempre, y en bytes
+typedef struct cache_stat_
+{
+  long long accesses;       /* number of memory references */
+  long long misses;         /* number of cache misses */
+  long long replacements;   /* number of misses that cause replacments */
+  long long demand_fetches; /* number of fetches (words) */
+  long long copies_back;    /* number of write backs (words) */
+  long long demand_bytes;   /* bytes fetched */
+  long long copies_back_bytes; /* bytes written back */
+} cache_stat, *Pcache_stat;
+
+// estadísticas del prefetcher de L1, sumadas sobre instrucciones
+// y datos. fetches está en palabras, aparte de demand_fetches
+typedef struct prefetch_stat_
+{
+  long long issued;    /* blocks brought by the prefetcher */
+  long long useful;    /* prefetched blocks later referenced */
+  long long late;      /* useful ones referenced before the prefetch latency */
+  long long polluting; /* misses to blocks that a prefetch had evicted */
+  long long fetches;   /* words fetched by the prefetcher */
+  long long fetch_bytes; /* bytes fetched by the prefetcher */
+} prefetch_stat, *Pprefetch_stat;
+
+/* L1 misses by cause (3C) and work of the victim caches */
+typedef struct miss_class_
+{
+  long long compulsory; /* first reference to the block */
+  long long capacity;   /* would also miss in a fully associative LRU cache */
+  long long conflict;   /* the rest: caused by the mapping to sets */
+} miss_class, *Pmiss_class;
+
+typedef struct victim_stat_
+{
+  long long hits;    /* L1 misses served by the victim cache */
+  long long inserts; /* blocks evicted from L1 into it */
+} victim_stat, *Pvictim_stat;
+
+// buffer de escritura de write through: las escrituras al mismo
+// bloque se combinan en una entrada y a memoria (o a L2) va una
+// escritura por entrada, con las palabras distintas que tenga
+typedef struct write_buffer_stat_
+{
+  long long stores; /* write-through stores that entered the buffer */
+  long long merged; /* stores combined into an entry already there */
+  long long stalls; /* stores that found the buffer full */
+  long long drains; /* entries written downstream */
+  long long words;  /* words written downstream, also in copies_back */
+} write_buffer_stat, *Pwrite_buffer_stat;
+
+// simulador opaco, definido en cache.h
+typedef struct cache_sim_ cache_sim, *Pcache_sim;
+
+/* function prototypes */
+// crea un simulador con la configuración default de cache.h
+Pcache_sim sim_create(void);
+// cambia un parámetro (CACHE_PARAM_*); solo se puede antes del
+// primer acceso. Regresa 0, o -1 si el parámetro no es válido.
+// CACHE_PARAM_SEED fija la semilla de REPLACE_RANDOM y REPLACE_BRRIP
+int sim_configure(Pcache_sim sim, int param, int value);
+// valida la configuración (bloque y número de sets potencias de
+// dos); imprime el problema y regresa -1 si no se puede simular
+int sim_check(Pcache_sim sim);
+// simula una referencia; regresa -1 si el tipo no es válido o si
+// la configuración no se puede simular (ver sim_check()); en ese
+// caso el simulador sigue sin inicializar
+int sim_access(Pcache_sim sim, sim_addr addr, unsigned access_type);
+// simula n referencias; types[i] y addrs[i] describen la i-ésima.
+// Regresa el número de referencias con tipo no válido, que se saltan,
+// o -1 sin simular nada si la configuración no se puede simular
+int sim_access_batch(Pcache_sim sim, const unsigned char *types, const sim_addr *addrs, int n);
+// las siguientes refs referencias válidas se simulan, pero al
+// terminarlas se borran todas las estadísticas (calentamiento)
+void sim_warmup(Pcache_sim sim, long long refs);
+// escribe a memoria las líneas sucias y vacía los caches
+void sim_flush(Pcache_sim sim);
+// copia las estadísticas de instrucciones y de datos
+void sim_stats(Pcache_sim sim, Pcache_stat inst, Pcache_stat data);
+// copia las estadísticas del nivel 2 (L2) o 3 (L3); regresa -1
+// si el simulador no tiene ese nivel
+int sim_level_stats(Pcache_sim sim, int level, Pcache_stat stat);
+// copia las estadísticas del prefetcher
+void sim_prefetch_stats(Pcache_sim sim, Pprefetch_stat stat);
+// copia los fallos de L1 por causa; regresa -1 si no se pidió
+// CACHE_PARAM_CLASSIFY
+int sim_miss_classes(Pcache_sim sim, Pmiss_class inst, Pmiss_class data);
+void sim_victim_stats(Pcache_sim sim, Pvictim_stat stat);
+// copia las estadísticas del buffer de escritura; regresa -1 si no
+// se pidió CACHE_PARAM_WRITE_BUFFER o el cache es write back
+int sim_write_buffer_stats(Pcache_sim sim, Pwrite_buffer_stat stat);
+// simulación repartida por sets: con sets independientes entre sí
+// (sin random, brrip, prefetcher, victim cache ni -3c), un cache se
+// puede partir en 2^shard_bits pedazos según los bits de dirección
+// [shard_shift, shard_shift + shard_bits), que deben ser bits de
+// índice de todos los niveles. sim_create_shard crea un simulador
+// con la configuración de sim y 1 / 2^shard_bits de sus sets, o
+// imprime el problema y regresa NULL. Cada shard recibe solo las
+// referencias de su parte, con la dirección que da sim_shard_address.
+// Al terminar, sim_merge_stats suma a sim (que no simula nada) las
+// estadísticas de cada shard ya vaciado con sim_flush
+Pcache_sim sim_create_shard(Pcache_sim sim, int shard_shift, int shard_bits);
+sim_addr sim_shard_address(sim_addr addr, int shard_shift, int shard_bits);
+void sim_merge_stats(Pcache_sim sim, Pcache_sim shard);
+// nombre de una política de reemplazo (REPLACE_*) y viceversa;
+// replacement_from_name regresa -1 si el nombre no existe
+const char *replacement_name(int policy);
+int replacement_from_name(const char *name);
+// nombre de una política de inclusión (INCLUSION_*) y la política
+// de un valor de -ip (nine, incl, excl), -1 si no existe
+const char *inclusion_name(int policy);
+int inclusion_from_name(const char *name);
+// nombre de un prefetcher (PREFETCH_*) y el prefetcher de un
+// valor de -pf (none, nextline, stride, stream, tagged), -1 si no existe
+const char *prefetcher_name(int kind);
+int prefetcher_from_name(const char *name);
+// nombre de una política de vaciado del buffer de escritura
+// (WBUF_DRAIN_*) y la de un valor de -wbd (eager, full), -1 si no existe
+const char *drain_name(int policy);
+int drain_from_name(const char *name);
+// imprime la configuración y las estadísticas como lo hace sim
+void sim_print_settings(Pcache_sim sim);
+void sim_print_stats(Pcache_sim sim);
+// libera el simulador y sus caches
+void sim_destroy(Pcache_sim sim);
+
+#endif
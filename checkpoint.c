@@ -0,0 +1,355 @@
+/*
+ * checkpoint.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "cache.h"
+#include "trace.h"
+#include "checkpoint.h"
+
+#if defined(_WIN32)
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+/************************************************************/
+// checkpoints del estado completo de los simuladores: cada cache
+// con sus líneas (dirty bits y estado de reemplazo), etiquetas,
+// set_contents, relojes, árboles de PLRU y generador aleatorio,
+// el prefetcher, la sombra de -3c, el victim cache, el buffer de
+// escritura, los niveles de abajo y las estadísticas, junto con
+// la posición de la traza.
+// Así una traza larga se calienta una sola vez y cualquier
+// barrido que incluya las mismas configuraciones sigue desde ahí.
+// Los arreglos se escriben completos con fwrite(), sin convertir.
+/************************************************************/
+
+/************************************************************/
+/* helper functions to write and read n bytes; -1 if they could not */
+static int put(FILE *file, const void *data, size_t n)
+{
+  return fwrite(data, 1, n, file) == n ? 0 : -1;
+}
+
+static int get(FILE *file, void *data, size_t n)
+{
+  return fread(data, 1, n, file) == n ? 0 : -1;
+}
+
+/* helper function to list the parameters that must match to restore a simulator */
+static void checkpoint_config(Pcache_sim sim, int *config)
+{
+  int n = 0, k;
+
+  config[n++] = sim->cache_split;
+  config[n++] = sim->cache_usize;
+  config[n++] = sim->cache_isize;
+  config[n++] = sim->cache_dsize;
+  config[n++] = sim->cache_block_size;
+  config[n++] = sim->cache_assoc;
+  config[n++] = sim->cache_writeback;
+  config[n++] = sim->cache_writealloc;
+  config[n++] = sim->replacement;
+  config[n++] = (int)sim->seed;
+  for (k = 0; k < MAX_LOWER_LEVELS; k++) {
+    config[n++] = sim->lower_size[k];
+    config[n++] = sim->lower_assoc[k];
+  }
+  config[n++] = sim->inclusion;
+  config[n++] = sim->prefetch_kind;
+  config[n++] = sim->prefetch_degree;
+  config[n++] = sim->prefetch_latency;
+  config[n++] = sim->classify;
+  config[n++] = sim->victim_entries;
+  config[n++] = sim->wbuf_entries;
+  config[n++] = sim->wbuf_drain;
+  config[n++] = sim->wbuf_rate;
+  config[n++] = MAX_LOWER_LEVELS;
+}
+/************************************************************/
+
+/************************************************************/
+// estado de un cache; lo que sigue a las líneas depende de la
+// configuración, así que al leer se sabe qué partes vienen
+static int save_cache(FILE *file, Pcache c)
+{
+  size_t lines = (size_t)c->n_sets * c->associativity;
+
+  if (put(file, c->lines, sizeof(cache_line) * lines) ||
+      put(file, &c->tag_bytes, sizeof(int)) ||
+      put(file, c->tags, (size_t)c->tag_bytes * lines) ||
+      put(file, c->set_contents, sizeof(int) * c->n_sets) ||
+      put(file, &c->lru_clock, sizeof(c->lru_clock)) ||
+      put(file, &c->rng_state, sizeof(c->rng_state)))
+    return -1;
+  if (c->set_bits && put(file, c->set_bits, sizeof(unsigned long long) * c->n_sets))
+    return -1;
+  if (c->prefetcher && put(file, c->prefetcher, sizeof(prefetcher)))
+    return -1;
+  if (c->shadow) {
+    Pshadow_cache sc = c->shadow;
+    if (put(file, &sc->used, sizeof(int)) || put(file, &sc->head, sizeof(int)) ||
+        put(file, &sc->tail, sizeof(int)) ||
+        put(file, sc->prev, sizeof(int) * sc->capacity) ||
+        put(file, sc->next, sizeof(int) * sc->capacity) ||
+        put(file, sc->blocks, sizeof(sim_addr) * sc->capacity) ||
+        put(file, &sc->map.map_size, sizeof(unsigned)) ||
+        put(file, &sc->map.n_blocks, sizeof(unsigned)) ||
+        put(file, sc->map.entries, sizeof(shadow_entry) * sc->map.map_size))
+      return -1;
+  }
+  if (c->victim) {
+    Pvictim_cache vc = c->victim;
+    if (put(file, &vc->count, sizeof(int)) || put(file, &vc->clock, sizeof(vc->clock)) ||
+        put(file, vc->blocks, sizeof(sim_addr) * vc->entries) ||
+        put(file, vc->dirty, vc->entries) ||
+        put(file, vc->stamp, sizeof(unsigned long long) * vc->entries))
+      return -1;
+  }
+  return 0;
+}
+
+static int load_cache(FILE *file, Pcache c)
+{
+  size_t lines = (size_t)c->n_sets * c->associativity;
+  int tag_bytes;
+
+  if (get(file, c->lines, sizeof(cache_line) * lines) ||
+      get(file, &tag_bytes, sizeof(int)) ||
+      (tag_bytes != sizeof(unsigned) && tag_bytes != sizeof(sim_addr)))
+    return -1;
+  // el cache recién creado tiene etiquetas de 32 bits; el guardado
+  // pudo haberlas ensanchado
+  if (tag_bytes != c->tag_bytes) {
+    free(c->tags);
+    c->tag_bytes = tag_bytes;
+    c->tags = calloc(lines + CACHE_TAG_LANES, tag_bytes);
+  }
+  if (get(file, c->tags, (size_t)tag_bytes * lines) ||
+      get(file, c->set_contents, sizeof(int) * c->n_sets) ||
+      get(file, &c->lru_clock, sizeof(c->lru_clock)) ||
+      get(file, &c->rng_state, sizeof(c->rng_state)))
+    return -1;
+  if (c->set_bits && get(file, c->set_bits, sizeof(unsigned long long) * c->n_sets))
+    return -1;
+  if (c->prefetcher && get(file, c->prefetcher, sizeof(prefetcher)))
+    return -1;
+  if (c->shadow) {
+    Pshadow_cache sc = c->shadow;
+    if (get(file, &sc->used, sizeof(int)) || get(file, &sc->head, sizeof(int)) ||
+        get(file, &sc->tail, sizeof(int)) ||
+        get(file, sc->prev, sizeof(int) * sc->capacity) ||
+        get(file, sc->next, sizeof(int) * sc->capacity) ||
+        get(file, sc->blocks, sizeof(sim_addr) * sc->capacity) ||
+        get(file, &sc->map.map_size, sizeof(unsigned)) ||
+        get(file, &sc->map.n_blocks, sizeof(unsigned)))
+      return -1;
+    // el mapa de bloques vistos crece durante la simulación
+    free(sc->map.entries);
+    sc->map.entries = (char *)malloc(sizeof(shadow_entry) * sc->map.map_size);
+    if (get(file, sc->map.entries, sizeof(shadow_entry) * sc->map.map_size))
+      return -1;
+  }
+  if (c->victim) {
+    Pvictim_cache vc = c->victim;
+    if (get(file, &vc->count, sizeof(int)) || get(file, &vc->clock, sizeof(vc->clock)) ||
+        get(file, vc->blocks, sizeof(sim_addr) * vc->entries) ||
+        get(file, vc->dirty, vc->entries) ||
+        get(file, vc->stamp, sizeof(unsigned long long) * vc->entries))
+      return -1;
+  }
+  return 0;
+}
+
+// estadísticas y caches de un simulador, en el orden de init_cache()
+static int save_sim(FILE *file, Pcache_sim sim)
+{
+  int k;
+
+  if (put(file, &sim->cache_stat_inst, sizeof(cache_stat)) ||
+      put(file, &sim->cache_stat_data, sizeof(cache_stat)) ||
+      put(file, sim->lower_stat, sizeof(sim->lower_stat)) ||
+      put(file, &sim->prefetch_stats, sizeof(prefetch_stat)) ||
+      put(file, &sim->class_inst, sizeof(miss_class)) ||
+      put(file, &sim->class_data, sizeof(miss_class)) ||
+      put(file, &sim->victim_stats, sizeof(victim_stat)) ||
+      put(file, &sim->wbuf_stats, sizeof(write_buffer_stat)) ||
+      put(file, &sim->clock_base, sizeof(sim->clock_base)) ||
+      save_cache(file, &sim->icache) ||
+      (sim->cache_split && save_cache(file, &sim->dcache)))
+    return -1;
+  if (sim->wbuf) {
+    Pwrite_buffer wb = sim->wbuf;
+    if (put(file, &wb->count, sizeof(int)) || put(file, &wb->busy_since, sizeof(wb->busy_since)) ||
+        put(file, wb->blocks, sizeof(sim_addr) * sim->wbuf_entries) ||
+        put(file, wb->masks, sizeof(unsigned long long) * sim->wbuf_entries * wb->mask_words))
+      return -1;
+  }
+  for (k = 0; k < sim->n_lower; k++)
+    if (save_cache(file, &sim->lower[k]))
+      return -1;
+  return 0;
+}
+
+// el simulador se inicializa con su configuración y después se
+// sobreescribe su estado
+static int load_sim(FILE *file, Pcache_sim sim)
+{
+  int k;
+
+  if (!sim->initialized && init_cache(sim))
+    return -1;
+  if (get(file, &sim->cache_stat_inst, sizeof(cache_stat)) ||
+      get(file, &sim->cache_stat_data, sizeof(cache_stat)) ||
+      get(file, sim->lower_stat, sizeof(sim->lower_stat)) ||
+      get(file, &sim->prefetch_stats, sizeof(prefetch_stat)) ||
+      get(file, &sim->class_inst, sizeof(miss_class)) ||
+      get(file, &sim->class_data, sizeof(miss_class)) ||
+      get(file, &sim->victim_stats, sizeof(victim_stat)) ||
+      get(file, &sim->wbuf_stats, sizeof(write_buffer_stat)) ||
+      get(file, &sim->clock_base, sizeof(sim->clock_base)) ||
+      load_cache(file, &sim->icache) ||
+      (sim->cache_split && load_cache(file, &sim->dcache)))
+    return -1;
+  if (sim->wbuf) {
+    Pwrite_buffer wb = sim->wbuf;
+    if (get(file, &wb->count, sizeof(int)) || get(file, &wb->busy_since, sizeof(wb->busy_since)) ||
+        get(file, wb->blocks, sizeof(sim_addr) * sim->wbuf_entries) ||
+        get(file, wb->masks, sizeof(unsigned long long) * sim->wbuf_entries * wb->mask_words))
+      return -1;
+  }
+  for (k = 0; k < sim->n_lower; k++)
+    if (load_cache(file, &sim->lower[k]))
+      return -1;
+  return 0;
+}
+/************************************************************/
+
+/************************************************************/
+// guarda en path el estado de los n_sims simuladores y la
+// posición de la traza después de records registros. Regresa -1
+// (e imprime el problema) si no se pudo escribir
+int write_checkpoint(path, sims, n_sims, reader, records)
+  const char *path;
+  Pcache_sim *sims;
+  int n_sims;
+  Ptrace_reader reader;
+  long long records;
+{
+  checkpoint_header header;
+  int config[CHECKPOINT_CONFIG], i, error = 0;
+  unsigned long long bytes;
+  off_t start, end;
+  FILE *file = fopen(path, "wb");
+
+  if (file == NULL) {
+    printf("error:  can not write checkpoint %s\n", path);
+    return -1;
+  }
+  setvbuf(file, NULL, _IOFBF, CHECKPOINT_BUFFER);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+  header.version = CHECKPOINT_VERSION;
+  header.line_size = sizeof(cache_line);
+  header.n_sims = n_sims;
+  header.records = records;
+  header.offset = trace_offset(reader, header.prev_addr);
+  header.trace_size = reader->mapped ? reader->size : 0;
+  error = put(file, &header, sizeof(header));
+
+  // el tamaño de cada registro se escribe al final, para poder
+  // saltar las configuraciones que no se piden al restaurar
+  for (i = 0; i < n_sims && !error; i++) {
+    if (!sims[i]->initialized && init_cache(sims[i])) {
+      error = -1;
+      break;
+    }
+    checkpoint_config(sims[i], config);
+    bytes = 0;
+    start = ftello(file);
+    error = put(file, &bytes, sizeof(bytes)) || put(file, config, sizeof(config)) ||
+            save_sim(file, sims[i]);
+    if (!error) {
+      end = ftello(file);
+      bytes = end - start - sizeof(bytes);
+      error = fseeko(file, start, SEEK_SET) || put(file, &bytes, sizeof(bytes)) ||
+              fseeko(file, end, SEEK_SET);
+    }
+  }
+  if (fclose(file) || error) {
+    printf("error:  can not write checkpoint %s\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+// restaura de path el estado de cada uno de los n_sims
+// simuladores, que no deben haber simulado nada; cada uno toma el
+// registro con su misma configuración. Deja la traza, recién
+// abierta, donde se tomó el checkpoint. Regresa -1 (e imprime el
+// problema) si no se pudo
+int read_checkpoint(path, sims, n_sims, reader)
+  const char *path;
+  Pcache_sim *sims;
+  int n_sims;
+  Ptrace_reader reader;
+{
+  checkpoint_header header;
+  int config[CHECKPOINT_CONFIG], wanted[CHECKPOINT_CONFIG];
+  unsigned long long bytes;
+  unsigned j;
+  int i, found, truncated;
+  FILE *file = fopen(path, "rb");
+
+  if (file == NULL) {
+    printf("error:  can not open checkpoint %s\n", path);
+    return -1;
+  }
+  setvbuf(file, NULL, _IOFBF, CHECKPOINT_BUFFER);
+  if (get(file, &header, sizeof(header)) || memcmp(header.magic, CHECKPOINT_MAGIC, 4) ||
+      header.version != CHECKPOINT_VERSION || header.line_size != sizeof(cache_line)) {
+    printf("error:  %s is not a checkpoint of this simulator\n", path);
+    fclose(file);
+    return -1;
+  }
+  if (header.offset >= 0 && reader->mapped && reader->size != header.trace_size) {
+    printf("error:  checkpoint %s was taken on a different trace\n", path);
+    fclose(file);
+    return -1;
+  }
+
+  for (i = 0; i < n_sims; i++) {
+    checkpoint_config(sims[i], wanted);
+    fseeko(file, sizeof(header), SEEK_SET);
+    found = truncated = FALSE;
+    for (j = 0; j < header.n_sims && !found && !truncated; j++) {
+      truncated = get(file, &bytes, sizeof(bytes)) || get(file, config, sizeof(config));
+      found = !truncated && !memcmp(config, wanted, sizeof(config));
+      if (!found && !truncated)
+        fseeko(file, bytes - sizeof(config), SEEK_CUR);
+    }
+    if (!found && !truncated) {
+      printf("error:  configuration %d is not in checkpoint %s\n", i, path);
+      fclose(file);
+      return -1;
+    }
+    if (truncated || load_sim(file, sims[i])) {
+      printf("error:  checkpoint %s is truncated\n", path);
+      fclose(file);
+      return -1;
+    }
+  }
+  fclose(file);
+
+  if (seek_trace(reader, header.offset, header.prev_addr, header.records)) {
+    printf("error:  the trace is shorter than checkpoint %s\n", path);
+    return -1;
+  }
+  return 0;
+}
+/************************************************************/
@@ -0,0 +1,31 @@
+/*
+ * checkpoint.h
+ */
+
+/* formato de los checkpoints de --checkpoint y --restore
+ * Encabezado (checkpoint_header) y, por configuración, un
+ * registro con su tamaño en bytes (uint64), los
+ * CHECKPOINT_CONFIG enteros de su configuración y el estado de
+ * sus caches. Se escribe tal como está en memoria, así que solo
+ * lo lee un simulador compilado igual en una máquina igual. */
+#define CHECKPOINT_MAGIC "SIMC"
+#define CHECKPOINT_VERSION 5
+#define CHECKPOINT_CONFIG 24
+/* buffer de stdio con el que se escribe y se lee */
+#define CHECKPOINT_BUFFER (1 << 20)
+
+/* structure definitions */
+typedef struct checkpoint_header_
+{
+  char magic[4];
+  unsigned version;
+  unsigned line_size;            /* sizeof(cache_line), depends on the build */
+  unsigned n_sims;               /* configurations in the file */
+  long long records;             /* trace records read before the checkpoint */
+  long long offset;              /* byte of the trace after them, -1 if unknown */
+  unsigned long long trace_size; /* bytes of the mapped trace, 0 if not mapped */
+  sim_addr prev_addr[4];         /* binary traces: previous address of each type */
+} checkpoint_header;
+
+int write_checkpoint();
+int read_checkpoint();
@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# comprueba que --restore da los mismos renglones que --warmup con
+# caches divididos y cada prefetcher, que miden el tiempo con las
+# referencias de los dos flujos. Uso: ./checkpoint_check.sh [sim]
+
+SIM=${1:-./sim}
+tmp=$(mktemp -d)
+trap 'rm -rf $tmp' EXIT
+
+# traza sintética determinista: dos de cada tres referencias son
+# fetches de instrucciones casi secuenciales, el resto datos con
+# saltos ocasionales
+awk 'BEGIN { srand(7); pc = 4194304; d = 268435456;
+  for (i = 0; i < 200000; i++) {
+    if (i % 3) { pc += (rand() < 0.1) ? int(rand() * 512) * 4 : 4; printf "2 %x\n", pc }
+    else { d += (rand() < 0.2) ? int(rand() * 65536) : 8; printf "%d %x\n", (rand() < 0.3), d }
+  } }' > $tmp/check.trace
+
+status=0
+for cfg in "-is 8192 -ds 8192 -bs 32 -pf nextline,stride,stream,tagged" \
+           "-is 8192 -ds 8192 -bs 32 -pf stride -l2 65536 -vc 4 -3c" \
+           "-is 8192 -ds 8192 -bs 32 -wt -wbn 8 -wbd eager,full";
+do
+    $SIM $cfg --warmup 50000 $tmp/check.trace > $tmp/warmup.csv
+    $SIM $cfg --warmup 50000 --checkpoint $tmp/state $tmp/check.trace > /dev/null
+    $SIM $cfg --restore $tmp/state $tmp/check.trace > $tmp/restore.csv
+    if cmp -s $tmp/warmup.csv $tmp/restore.csv; then
+        echo "ok:   $cfg"
+    else
+        echo "FAIL: $cfg"
+        diff $tmp/warmup.csv $tmp/restore.csv
+        status=1
+    fi
+done
+exit $status
@@ -0,0 +1,148 @@
+/*
+ * classify.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "cache.h"
+#include "classify.h"
+
+/************************************************************/
+// clasificación de los fallos de L1 en las tres C de Hill:
+//   compulsory: primera referencia al bloque
+//   capacity:   el bloque ya se vio, pero tampoco estaría en un
+//               cache totalmente asociativo LRU del mismo tamaño
+//   conflict:   estaría en ese cache; lo sacó el mapeo a sets
+// Cada L1 tiene su sombra, que ve las mismas referencias de
+// demanda y con la misma política de alocación. Cada referencia
+// cuesta una búsqueda en el hash y mover un nodo de la lista.
+/************************************************************/
+
+/************************************************************/
+// funciones de la lista LRU de la sombra
+static void shadow_unlink(Pshadow_cache sc, int n)
+{
+  int p = sc->prev[n], x = sc->next[n];
+
+  if (p >= 0) sc->next[p] = x; else sc->head = x;
+  if (x >= 0) sc->prev[x] = p; else sc->tail = p;
+}
+
+static void shadow_push(Pshadow_cache sc, int n)
+{
+  sc->prev[n] = -1;
+  sc->next[n] = sc->head;
+  if (sc->head >= 0) sc->prev[sc->head] = n; else sc->tail = n;
+  sc->head = n;
+}
+/************************************************************/
+
+/************************************************************/
+/* gives an L1 cache its shadow cache, or none */
+void init_shadow(Pcache ptr_cache, int enabled)
+{
+  Pshadow_cache sc;
+
+  ptr_cache->shadow = NULL;
+  if (!enabled) {
+    return;
+  }
+  sc = (Pshadow_cache)calloc(1, sizeof(shadow_cache));
+  sc->capacity = ptr_cache->n_sets * ptr_cache->associativity;
+  sc->head = sc->tail = -1;
+  sc->prev = (int *)malloc(sizeof(int) * sc->capacity);
+  sc->next = (int *)malloc(sizeof(int) * sc->capacity);
+  sc->blocks = (sim_addr *)malloc(sizeof(sim_addr) * sc->capacity);
+  init_block_map(&sc->map, sizeof(shadow_entry), SHADOW_INITIAL_BLOCKS);
+  ptr_cache->shadow = sc;
+}
+
+void free_shadow(Pshadow_cache sc)
+{
+  if (sc) {
+    free(sc->prev);
+    free(sc->next);
+    free(sc->blocks);
+    free_block_map(&sc->map);
+    free(sc);
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// pasa por la sombra de ptr_cache la referencia al bloque
+// (index, tag) y, si fue un fallo en L1 (is_hit FALSE), lo cuenta
+// en la clase que le toca. allocate es FALSE para las escrituras
+// que fallan con no write allocate, que no entran a ningún cache
+void classify_access(Pcache_sim sim, Pcache ptr_cache, unsigned access_type, int index,
+                     sim_addr tag, int is_hit, int allocate)
+{
+  Pshadow_cache sc = ptr_cache->shadow;
+  sim_addr block = block_address(ptr_cache, index, tag) >> ptr_cache->index_mask_offset;
+  Pmiss_class stat = access_type < 2 ? &sim->class_data : &sim->class_inst;
+  int is_new, n;
+  shadow_entry *entry = (shadow_entry *)block_map_find(&sc->map, block, &is_new);
+
+  if (is_new) {
+    entry->node = -1;
+  }
+  if (entry->node > 0) {
+    n = entry->node - 1;
+    if (n != sc->head) {
+      shadow_unlink(sc, n);
+      shadow_push(sc, n);
+    }
+    // hit en la sombra: si L1 falló, fue por conflicto
+    stat->conflict += !is_hit;
+    return;
+  }
+
+  if (!is_hit) {
+    if (is_new) {
+      stat->compulsory++;
+    } else {
+      stat->capacity++;
+    }
+  }
+  if (!allocate) {
+    return;
+  }
+
+  if (sc->used < sc->capacity) {
+    n = sc->used++;
+  } else {
+    // sale el bloque menos recientemente usado de la sombra
+    n = sc->tail;
+    shadow_unlink(sc, n);
+    ((shadow_entry *)block_map_find(&sc->map, sc->blocks[n], &is_new))->node = -1;
+  }
+  sc->blocks[n] = block;
+  shadow_push(sc, n);
+  entry->node = n + 1;
+}
+/************************************************************/
+
+/************************************************************/
+// imprime los fallos por clase, como print_stats(). En modo CSV
+// agrega al renglón las tres clases de instrucciones y de datos
+void print_classify_stats(Pcache_sim sim)
+{
+  if (!sim->classify) {
+    return;
+  }
+  if (sim->debug) {
+    printf(" MISS CLASSES (compulsory, capacity, conflict)\n");
+    printf("  instructions:  %lld, %lld, %lld\n", sim->class_inst.compulsory,
+    sim->class_inst.capacity, sim->class_inst.conflict);
+    printf("  data:          %lld, %lld, %lld\n", sim->class_data.compulsory,
+    sim->class_data.capacity, sim->class_data.conflict);
+    printf("\n");
+  } else {
+    printf(",%lld,%lld,%lld", sim->class_inst.compulsory, sim->class_inst.capacity,
+    sim->class_inst.conflict);
+    printf(",%lld,%lld,%lld", sim->class_data.compulsory, sim->class_data.capacity,
+    sim->class_data.conflict);
+  }
+}
+/************************************************************/
@@ -0,0 +1,8 @@
+/*
+ * classify.h
+ */
+
+void init_shadow();
+void free_shadow();
+void classify_access();
+void print_classify_stats();
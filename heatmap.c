@@ -0,0 +1,225 @@
+/*
+ * heatmap.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+#include "heatmap.h"
+
+/************************************************************/
+// mapa de calor de L1: por cada set, accesos, fallos, líneas
+// reemplazadas, palabras escritas de regreso y líneas válidas al
+// final; por cada región de memoria (páginas de 2^bits bytes),
+// accesos, fallos, escrituras, reemplazos y copies back de sus
+// bloques. Los sets muestran los conflictos que se concentran en
+// pocos sets y las regiones, qué rangos de direcciones causan los
+// fallos y el tráfico de copies back. Las regiones se guardan en
+// una tabla de tamaño fijo (ver region_map en cache.h), así que
+// la memoria no crece con trazas enormes.
+/************************************************************/
+
+/************************************************************/
+/* gives the L1 caches of sim their per-set counters and sim its
+ * region table, if CACHE_PARAM_HEATMAP was given */
+void init_heatmap(Pcache_sim sim)
+{
+  sim->icache.heat = NULL;
+  sim->dcache.heat = NULL;
+  sim->regions = NULL;
+  if (!sim->heatmap) {
+    return;
+  }
+  sim->icache.heat = (Pset_heat)calloc(sim->icache.n_sets, sizeof(set_heat));
+  if (sim->cache_split) {
+    sim->dcache.heat = (Pset_heat)calloc(sim->dcache.n_sets, sizeof(set_heat));
+  }
+  sim->regions = (Pregion_map)calloc(1, sizeof(region_map));
+  sim->regions->bits = sim->heatmap;
+}
+
+void free_heatmap(Pcache_sim sim)
+{
+  free(sim->icache.heat);
+  if (sim->cache_split) {
+    free(sim->dcache.heat);
+  }
+  free(sim->regions);
+}
+
+/* helper function to find the counters of the region of addr;
+ * a new region takes an empty slot while there is room */
+static Pregion_heat region_find(Pregion_map map, sim_addr addr)
+{
+  sim_addr key = (addr >> map->bits) + 1;
+  unsigned slot = BLOCK_HASH(key) & (HEATMAP_REGION_SLOTS - 1);
+
+  while (map->slots[slot].key != key) {
+    if (map->slots[slot].key == 0) {
+      if (map->used == HEATMAP_REGION_MAX) {
+        return &map->other;
+      }
+      map->slots[slot].key = key;
+      map->used++;
+      break;
+    }
+    slot = (slot + 1) & (HEATMAP_REGION_SLOTS - 1);
+  }
+  return &map->slots[slot];
+}
+/************************************************************/
+
+/************************************************************/
+// una referencia a L1 al set index con etiqueta tag
+void heatmap_access(Pcache_sim sim, Pcache ptr_cache, unsigned access_type, int index,
+                    sim_addr tag, int is_hit)
+{
+  Pset_heat set = &ptr_cache->heat[index];
+  Pregion_heat region = region_find(sim->regions, block_address(ptr_cache, index, tag));
+
+  set->accesses++;
+  set->misses += !is_hit;
+  region->accesses++;
+  region->misses += !is_hit;
+  region->stores += access_type == TRACE_DATA_STORE;
+}
+
+// la línea que sacó un fallo de L1, antes de que pase al victim
+// cache: cuenta para el set y para la región del bloque que sale
+void heatmap_evict(Pcache_sim sim, Pcache ptr_cache, int index, Pinsertion_response response)
+{
+  Pset_heat set = &ptr_cache->heat[index];
+  Pregion_heat region;
+  int words = response->dirty_bit * sim->words_per_block;
+
+  if (!response->replacement) {
+    return;
+  }
+  region = region_find(sim->regions, block_address(ptr_cache, index, response->victim_tag));
+  set->evictions++;
+  set->copies_back += words;
+  region->evictions++;
+  region->copies_back += words;
+}
+
+// el set i de data en el flush final, antes de vaciarse
+void heatmap_flush_set(Pcache_sim sim, Pcache data, int i)
+{
+  Pset_heat set = &data->heat[i];
+  Pcache_line lines = &data->lines[i * data->associativity];
+
+  set->occupancy = data->set_contents[i];
+  for (int j = 0; j < data->set_contents[i]; j++) {
+    if (lines[j].dirty) {
+      set->copies_back += sim->words_per_block;
+      region_find(sim->regions, block_address(data, i, line_tag(data, i * data->associativity + j)))
+        ->copies_back += sim->words_per_block;
+    }
+  }
+}
+
+// al terminar el calentamiento se olvida todo lo contado
+void heatmap_reset(Pcache_sim sim)
+{
+  int bits = sim->regions->bits;
+
+  memset(sim->icache.heat, 0, sizeof(set_heat) * sim->icache.n_sets);
+  if (sim->cache_split) {
+    memset(sim->dcache.heat, 0, sizeof(set_heat) * sim->dcache.n_sets);
+  }
+  memset(sim->regions, 0, sizeof(region_map));
+  sim->regions->bits = bits;
+}
+/************************************************************/
+
+/************************************************************/
+/* helper function to order regions by misses, then copies back,
+ * then address */
+static int compare_regions(const void *a, const void *b)
+{
+  Pregion_heat x = *(Pregion_heat *)a, y = *(Pregion_heat *)b;
+
+  if (x->misses != y->misses) {
+    return x->misses < y->misses ? 1 : -1;
+  }
+  if (x->copies_back != y->copies_back) {
+    return x->copies_back < y->copies_back ? 1 : -1;
+  }
+  return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/* helper function to write the rows of the sets of one L1 cache */
+static void write_sets(FILE *file, int config, const char *name, Pcache ptr_cache)
+{
+  for (int i = 0; i < ptr_cache->n_sets; i++) {
+    Pset_heat set = &ptr_cache->heat[i];
+    fprintf(file, "%d,%s,%d,%lld,%lld,%lld,%lld,%d\n", config, name, i, set->accesses,
+            set->misses, set->evictions, set->copies_back, set->occupancy);
+  }
+}
+
+/* helper function to write one row of the region table */
+static void write_region(FILE *file, int config, Pregion_heat region, int bits)
+{
+  if (region->key)
+    fprintf(file, "%d,0x%llx,", config, (region->key - 1) << bits);
+  else
+    fprintf(file, "%d,other,", config);
+  fprintf(file, "%lld,%lld,%lld,%lld,%lld\n", region->accesses, region->misses,
+          region->stores, region->evictions, region->copies_back);
+}
+
+// escribe los mapas de calor de los simuladores que lo tienen,
+// ya vaciados con flush(), en <prefix>-sets.csv y
+// <prefix>-regions.csv; config es el número de renglón de cada
+// configuración en los resultados. Las regiones van de la que
+// más falla a la que menos. Regresa -1 si no se pudo escribir
+int write_heatmaps(const char *prefix, Pcache_sim *sims, int n_sims)
+{
+  char *name = (char *)malloc(strlen(prefix) + sizeof("-regions.csv"));
+  Pregion_heat order[HEATMAP_REGION_MAX];
+  FILE *sets, *regions;
+  int k, i, n;
+
+  sprintf(name, "%s-sets.csv", prefix);
+  sets = fopen(name, "w");
+  sprintf(name, "%s-regions.csv", prefix);
+  regions = fopen(name, "w");
+  free(name);
+  if (sets == NULL || regions == NULL) {
+    if (sets)
+      fclose(sets);
+    if (regions)
+      fclose(regions);
+    return (-1);
+  }
+
+  fprintf(sets, "config,cache,set,accesses,misses,evictions,copies_back,occupancy\n");
+  fprintf(regions, "config,region,accesses,misses,stores,evictions,copies_back\n");
+  for (k = 0; k < n_sims; k++) {
+    Pcache_sim sim = sims[k];
+    Pregion_map map = sim->regions;
+
+    if (map == NULL)
+      continue;
+    write_sets(sets, k, sim->cache_split ? "i" : "u", &sim->icache);
+    if (sim->cache_split)
+      write_sets(sets, k, "d", &sim->dcache);
+
+    n = 0;
+    for (i = 0; i < HEATMAP_REGION_SLOTS; i++)
+      if (map->slots[i].key)
+        order[n++] = &map->slots[i];
+    qsort(order, n, sizeof(Pregion_heat), compare_regions);
+    for (i = 0; i < n; i++)
+      write_region(regions, k, order[i], map->bits);
+    if (map->other.accesses || map->other.evictions || map->other.copies_back)
+      write_region(regions, k, &map->other, map->bits);
+  }
+  if (fclose(sets) | fclose(regions))
+    return (-1);
+  return (0);
+}
+/************************************************************/
@@ -0,0 +1,14 @@
+/*
+ * heatmap.h
+ */
+
+/* tamaño default de las regiones de -hm: páginas de 4 KB */
+#define DEFAULT_HEATMAP_REGION_BITS 12
+
+void init_heatmap();
+void free_heatmap();
+void heatmap_access();
+void heatmap_evict();
+void heatmap_flush_set();
+void heatmap_reset();
+int write_heatmaps();
@@ -0,0 +1,366 @@
+/*
+ * hierarchy.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+#include "hierarchy.h"
+#include "victim.h"
+
+/************************************************************/
+// niveles L2 y L3: caches unificados debajo de L1 que usan las
+// mismas funciones de búsqueda, inserción y reemplazo que L1.
+// Los fallos de un nivel se vuelven lecturas del siguiente y sus
+// write backs, escrituras; el último nivel habla con memoria, así
+// que su demand_fetches y copies_back son el tráfico a memoria.
+// Las políticas de inclusión:
+//   INCLUSION_NONE:      cada nivel llena y reemplaza por su cuenta
+//   INCLUSION_INCLUSIVE: al reemplazar un bloque en un nivel se
+//                        invalida en los de arriba (back invalidation)
+//   INCLUSION_EXCLUSIVE: un bloque vive en un solo nivel; un hit
+//                        abajo lo sube y los reemplazados de arriba,
+//                        limpios o sucios, bajan al siguiente nivel
+/************************************************************/
+
+/* names of the inclusion policies, indexed by INCLUSION_* */
+static const char *inclusion_names[INCLUSION_POLICIES] = {
+  "NON-INCLUSIVE", "INCLUSIVE", "EXCLUSIVE"
+};
+
+/* names accepted by inclusion_from_name(), same order */
+static const char *inclusion_options[INCLUSION_POLICIES] = {
+  "nine", "incl", "excl"
+};
+
+const char *inclusion_name(int policy)
+{
+  return inclusion_names[policy];
+}
+
+/* policy of a -ip option value, -1 if unknown */
+int inclusion_from_name(const char *name)
+{
+  for (int policy = 0; policy < INCLUSION_POLICIES; policy++) {
+    if (!strcmp(name, inclusion_options[policy])) {
+      return policy;
+    }
+  }
+  return -1;
+}
+
+/************************************************************/
+// invalida un bloque en todos los caches arriba del nivel k
+// (L1 y los niveles inferiores anteriores a k). Regresa TRUE si
+// alguna de las copias estaba sucia: su contenido se va con el
+// bloque que se reemplaza en el nivel k
+static int back_invalidate(Pcache_sim sim, int k, sim_addr addr)
+{
+  Pcache upper[2 + MAX_LOWER_LEVELS];
+  int n = 0, dirty = FALSE;
+
+  upper[n++] = sim->ptr_icache;
+  if (sim->cache_split) {
+    upper[n++] = sim->ptr_dcache;
+  }
+  for (int j = 0; j < k; j++) {
+    upper[n++] = &sim->lower[j];
+  }
+
+  for (int i = 0; i < n; i++) {
+    int index = getLineIndex(upper[i], addr);
+    int way = get_line_way(upper[i], index, getTag(upper[i], addr));
+    if (way >= 0) {
+      dirty |= upper[i]->lines[index * upper[i]->associativity + way].dirty;
+      invalidate_line(upper[i], index, way);
+    }
+    dirty |= victim_invalidate(upper[i], addr);
+  }
+  return dirty;
+}
+/************************************************************/
+
+/************************************************************/
+// referencia al nivel k de una jerarquía inclusiva o no inclusiva.
+// Los niveles inferiores son write back y write allocate; un write
+// back trae el bloque completo, así que no necesita leerlo abajo
+static void lower_access(Pcache_sim sim, int k, sim_addr addr, int kind)
+{
+  Pcache ptr_cache = &sim->lower[k];
+  Pcache_stat stat = &sim->lower_stat[k];
+  int index = getLineIndex(ptr_cache, addr);
+  sim_addr tag = getTag(ptr_cache, addr);
+  int way = get_line_way(ptr_cache, index, tag);
+  insertion_response response;
+
+  stat->accesses++;
+  if (way >= 0) {
+    touch_line(ptr_cache, index, way);
+    if (kind != LOWER_READ) {
+      ptr_cache->lines[index * ptr_cache->associativity + way].dirty = TRUE;
+    }
+    return;
+  }
+
+  stat->misses++;
+  response = full_insert(ptr_cache, index, tag);
+  stat->replacements += response.replacement;
+  // el estado del bloque nuevo se fija antes de bajar: lo que pase
+  // en los niveles de abajo puede mover las líneas de este set
+  if (kind != LOWER_READ) {
+    ptr_cache->lines[index * ptr_cache->associativity + response.way].dirty = TRUE;
+  }
+
+  if (response.replacement) {
+    sim_addr victim = block_address(ptr_cache, index, response.victim_tag);
+    int dirty = response.dirty_bit;
+    if (sim->inclusion == INCLUSION_INCLUSIVE && !sim->flushing) {
+      dirty |= back_invalidate(sim, k, victim);
+    }
+    if (dirty) {
+      COUNT_COPY_BACK(stat, sim->words_per_block);
+      if (k + 1 < sim->n_lower) {
+        lower_access(sim, k + 1, victim, LOWER_WRITEBACK);
+      }
+    }
+  }
+
+  if (kind != LOWER_WRITEBACK) {
+    COUNT_DEMAND_FETCH(stat, sim->words_per_block);
+    if (k + 1 < sim->n_lower) {
+      lower_access(sim, k + 1, addr, LOWER_READ);
+    }
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// lectura de un bloque en una jerarquía exclusiva: si el nivel k
+// lo tiene, sale de ahí hacia arriba; si no, se busca más abajo.
+// Regresa TRUE si el bloque sube sucio
+static int exclusive_read(Pcache_sim sim, int k, sim_addr addr)
+{
+  Pcache ptr_cache = &sim->lower[k];
+  Pcache_stat stat = &sim->lower_stat[k];
+  int index = getLineIndex(ptr_cache, addr);
+  int way = get_line_way(ptr_cache, index, getTag(ptr_cache, addr));
+  int dirty;
+
+  stat->accesses++;
+  if (way >= 0) {
+    dirty = ptr_cache->lines[index * ptr_cache->associativity + way].dirty;
+    invalidate_line(ptr_cache, index, way);
+    return dirty;
+  }
+
+  stat->misses++;
+  COUNT_DEMAND_FETCH(stat, sim->words_per_block);
+  return (k + 1 < sim->n_lower) ? exclusive_read(sim, k + 1, addr) : FALSE;
+}
+
+// un bloque reemplazado arriba entra al nivel k de una jerarquía
+// exclusiva; lo que este nivel reemplace baja al siguiente
+static void exclusive_insert(Pcache_sim sim, int k, sim_addr addr, int dirty)
+{
+  Pcache ptr_cache = &sim->lower[k];
+  Pcache_stat stat = &sim->lower_stat[k];
+  int index = getLineIndex(ptr_cache, addr);
+  sim_addr tag = getTag(ptr_cache, addr);
+  int way = get_line_way(ptr_cache, index, tag);
+  insertion_response response;
+
+  stat->accesses++;
+  if (way >= 0) {
+    // solo pasa si una escritura directa ya lo había traído
+    touch_line(ptr_cache, index, way);
+    ptr_cache->lines[index * ptr_cache->associativity + way].dirty |= dirty;
+    return;
+  }
+
+  response = full_insert(ptr_cache, index, tag);
+  stat->replacements += response.replacement;
+  ptr_cache->lines[index * ptr_cache->associativity + response.way].dirty = dirty;
+  if (response.replacement) {
+    COUNT_COPY_BACK(stat, response.dirty_bit * sim->words_per_block);
+    if (k + 1 < sim->n_lower) {
+      exclusive_insert(sim, k + 1, block_address(ptr_cache, index, response.victim_tag),
+                       response.dirty_bit);
+    }
+  }
+}
+
+// escritura de una palabra en una jerarquía exclusiva: se marca
+// el nivel que tenga el bloque, sin traerlo a los que no lo tienen
+static void exclusive_write(Pcache_sim sim, int k, sim_addr addr)
+{
+  Pcache ptr_cache = &sim->lower[k];
+  int index = getLineIndex(ptr_cache, addr);
+  int way = get_line_way(ptr_cache, index, getTag(ptr_cache, addr));
+
+  sim->lower_stat[k].accesses++;
+  if (way >= 0) {
+    touch_line(ptr_cache, index, way);
+    ptr_cache->lines[index * ptr_cache->associativity + way].dirty = TRUE;
+    return;
+  }
+  sim->lower_stat[k].misses++;
+  if (k + 1 < sim->n_lower) {
+    exclusive_write(sim, k + 1, addr);
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// un fallo de L1 que trae el bloque (index, tag) a ptr_cache: el
+// bloque se lee de L2 (salvo que fetch sea 0 porque ya estaba en
+// un stream buffer) y el reemplazado, si lo hubo, se escribe en
+// L2 (solo si está sucio, salvo en una jerarquía exclusiva).
+// ptr_cache ya tiene la línea nueva en response.way
+void hierarchy_fill(Pcache_sim sim, Pcache ptr_cache, int index, sim_addr tag,
+                    insertion_response response, int fetch)
+{
+  sim_addr addr = block_address(ptr_cache, index, tag);
+
+  if (sim->inclusion == INCLUSION_EXCLUSIVE) {
+    if (fetch && exclusive_read(sim, 0, addr)) {
+      ptr_cache->lines[index * ptr_cache->associativity + response.way].dirty = TRUE;
+    }
+    if (response.replacement) {
+      exclusive_insert(sim, 0, block_address(ptr_cache, index, response.victim_tag),
+                       response.dirty_bit);
+    }
+    return;
+  }
+
+  if (fetch) {
+    lower_access(sim, 0, addr, LOWER_READ);
+  }
+  if (response.replacement && response.dirty_bit) {
+    lower_access(sim, 0, block_address(ptr_cache, index, response.victim_tag), LOWER_WRITEBACK);
+  }
+}
+
+// lectura de un bloque que no entra a L1 (stream buffers); regresa
+// TRUE si en una jerarquía exclusiva el bloque sube sucio
+int hierarchy_read(Pcache_sim sim, sim_addr addr)
+{
+  if (sim->inclusion == INCLUSION_EXCLUSIVE) {
+    return exclusive_read(sim, 0, addr);
+  }
+  lower_access(sim, 0, addr, LOWER_READ);
+  return FALSE;
+}
+
+// una escritura de L1 que va directo al siguiente nivel (write
+// through o no write allocate)
+void hierarchy_write(Pcache_sim sim, sim_addr addr)
+{
+  if (sim->inclusion == INCLUSION_EXCLUSIVE) {
+    exclusive_write(sim, 0, addr);
+  } else {
+    lower_access(sim, 0, addr, LOWER_WRITE);
+  }
+}
+
+// un bloque sucio que se escribe en el nivel k
+void lower_writeback(Pcache_sim sim, int k, sim_addr addr)
+{
+  if (sim->inclusion == INCLUSION_EXCLUSIVE) {
+    exclusive_insert(sim, k, addr, TRUE);
+  } else {
+    lower_access(sim, k, addr, LOWER_WRITEBACK);
+  }
+}
+
+// un bloque que sale de un victim cache de L1: en una jerarquía
+// exclusiva baja a L2 aunque esté limpio; si no, solo si está sucio
+void hierarchy_evict(Pcache_sim sim, sim_addr addr, int dirty)
+{
+  if (sim->inclusion == INCLUSION_EXCLUSIVE) {
+    exclusive_insert(sim, 0, addr, dirty);
+  } else if (dirty) {
+    lower_access(sim, 0, addr, LOWER_WRITEBACK);
+  }
+}
+
+// vacía L2 y L3 en orden, después de L1: las líneas sucias de
+// cada nivel se escriben en el siguiente, y las del último en
+// memoria
+void hierarchy_flush(Pcache_sim sim)
+{
+  for (int k = 0; k < sim->n_lower; k++) {
+    Pcache ptr_cache = &sim->lower[k];
+    for (int i = 0; i < ptr_cache->n_sets; i++) {
+      for (int j = 0; j < ptr_cache->set_contents[i]; j++) {
+        int line = i * ptr_cache->associativity + j;
+        if (!ptr_cache->lines[line].dirty) {
+          continue;
+        }
+        COUNT_COPY_BACK(&sim->lower_stat[k], sim->words_per_block);
+        if (k + 1 < sim->n_lower) {
+          lower_writeback(sim, k + 1, block_address(ptr_cache, i, line_tag(ptr_cache, line)));
+        }
+      }
+      ptr_cache->set_contents[i] = 0;
+    }
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// imprime la configuración de L2 y L3, como dump_settings()
+void dump_lower_settings(Pcache_sim sim)
+{
+  for (int k = 0; k < MAX_LOWER_LEVELS && sim->lower_size[k] > 0; k++) {
+    printf("  L%d size: \t\t%d\n", k + 2, sim->lower_size[k]);
+    printf("  L%d associativity: \t%d\n", k + 2, sim->lower_assoc[k]);
+  }
+  if (sim->lower_size[0] > 0) {
+    printf("  Inclusion policy: \t%s\n", inclusion_name(sim->inclusion));
+  }
+}
+
+// imprime las estadísticas de L2 y L3, como print_stats(). En
+// modo CSV agrega al renglón la política de inclusión y, por
+// nivel, tamaño, asociatividad y las mismas columnas que L1
+void print_lower_stats(Pcache_sim sim)
+{
+  if (!sim->n_lower) {
+    return;
+  }
+  if (sim->debug) {
+    for (int k = 0; k < sim->n_lower; k++) {
+      Pcache_stat stat = &sim->lower_stat[k];
+      printf(" L%d (%s)\n", k + 2, inclusion_name(sim->inclusion));
+      printf("  accesses:  %lld\n", stat->accesses);
+      printf("  misses:    %lld\n", stat->misses);
+      if (!stat->accesses)
+        printf("  miss rate: 0 (0)\n");
+      else
+        printf("  miss rate: %2.4f (hit rate %2.4f)\n",
+      (float)stat->misses / (float)stat->accesses,
+      1.0 - (float)stat->misses / (float)stat->accesses);
+      printf("  replace:   %lld\n", stat->replacements);
+      printf("  demand fetch:  %lld (%lld bytes)\n", stat->demand_fetches, stat->demand_bytes);
+      printf("  copies back:   %lld (%lld bytes)\n", stat->copies_back, stat->copies_back_bytes);
+    }
+    printf("\n");
+  } else {
+    printf(",%s", inclusion_name(sim->inclusion));
+    for (int k = 0; k < sim->n_lower; k++) {
+      Pcache_stat stat = &sim->lower_stat[k];
+      printf(",%d,%d", sim->lower_size[k], sim->lower_assoc[k]);
+      printf(",%lld,%lld", stat->accesses, stat->misses);
+      if (!stat->accesses)
+        printf(",0,0");
+      else
+        printf(",%2.4f,%2.4f",
+      (float)stat->misses / (float)stat->accesses,
+      1.0 - (float)stat->misses / (float)stat->accesses);
+      printf(",%lld,%lld,%lld", stat->replacements, stat->demand_fetches, stat->copies_back);
+    }
+  }
+}
+/************************************************************/
@@ -0,0 +1,17 @@
+/*
+ * hierarchy.h
+ */
+
+/* tipos de referencia que recibe un nivel inferior */
+#define LOWER_READ 0      /* fill of a block that missed above */
+#define LOWER_WRITE 1     /* word written through from above */
+#define LOWER_WRITEBACK 2 /* dirty block evicted from above */
+
+void hierarchy_fill();
+int hierarchy_read();
+void hierarchy_write();
+void hierarchy_flush();
+void lower_writeback();
+void hierarchy_evict();
+void dump_lower_settings();
+void print_lower_stats();
@@ -0,0 +1,174 @@
+/*
+ * interval.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+#include "interval.h"
+
+/************************************************************/
+// estadísticas por intervalo. Las sumas de print_stats() ocultan
+// las fases del programa y el calentamiento de los caches; aquí
+// cada configuración escribe un renglón CSV por ventana con lo que
+// cambiaron sus contadores. Los bloques de la traza se cortan en
+// el fin de cada ventana, así que una ventana contiene exactamente
+// window referencias, y los renglones se juntan en un buffer por
+// configuración para que escribirlos casi no cueste. La suma de
+// las ventanas de una configuración es su renglón de resultados
+// (el último intervalo incluye el flush).
+/************************************************************/
+
+/************************************************************/
+/* helper function to write out the buffered rows of a series */
+static void interval_write(Pinterval_series series)
+{
+  if (!series->used)
+    return;
+  pthread_mutex_lock(&series->out->mutex);
+  fwrite(series->buffer, 1, series->used, series->out->file);
+  pthread_mutex_unlock(&series->out->mutex);
+  series->used = 0;
+}
+
+// agrega el renglón de la ventana que termina aquí: posición en
+// la traza y, por flujo, hits, fallos, reemplazos, demand fetch
+// y copies back (en palabras y en bytes) desde la ventana anterior
+static void interval_emit(Pinterval_series series)
+{
+  cache_stat inst, data;
+  Pcache_stat li = &series->last_inst, ld = &series->last_data;
+
+  sim_stats(series->sim, &inst, &data);
+  if (INTERVAL_BUFFER - series->used < INTERVAL_LINE)
+    interval_write(series);
+  series->used += snprintf(series->buffer + series->used, INTERVAL_BUFFER - series->used,
+    "%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n",
+    series->config, series->interval, series->refs, series->insts,
+    (inst.accesses - inst.misses) - (li->accesses - li->misses), inst.misses - li->misses,
+    inst.replacements - li->replacements, inst.demand_fetches - li->demand_fetches,
+    inst.copies_back - li->copies_back, inst.demand_bytes - li->demand_bytes,
+    inst.copies_back_bytes - li->copies_back_bytes,
+    (data.accesses - data.misses) - (ld->accesses - ld->misses), data.misses - ld->misses,
+    data.replacements - ld->replacements, data.demand_fetches - ld->demand_fetches,
+    data.copies_back - ld->copies_back, data.demand_bytes - ld->demand_bytes,
+    data.copies_back_bytes - ld->copies_back_bytes);
+  series->interval++;
+  *li = inst;
+  *ld = data;
+}
+/************************************************************/
+
+/************************************************************/
+// abre el archivo de la serie (NULL o "-" es stderr, para no
+// mezclarla con los renglones de resultados) y escribe el
+// encabezado. Regresa NULL si no se pudo abrir
+Pinterval_output open_interval_output(name)
+  const char *name;
+{
+  Pinterval_output out = (Pinterval_output)calloc(1, sizeof(interval_output));
+
+  if (name == NULL || !strcmp(name, "-")) {
+    out->file = stderr;
+  } else {
+    out->file = fopen(name, "w");
+    out->close = TRUE;
+  }
+  if (out->file == NULL) {
+    free(out);
+    return NULL;
+  }
+  pthread_mutex_init(&out->mutex, NULL);
+  fprintf(out->file, "config,interval,refs,insts,"
+          "i_hits,i_misses,i_replacements,i_demand_fetch,i_copies_back,i_demand_bytes,i_copies_back_bytes,"
+          "d_hits,d_misses,d_replacements,d_demand_fetch,d_copies_back,d_demand_bytes,d_copies_back_bytes\n");
+  return out;
+}
+
+void close_interval_output(out)
+  Pinterval_output out;
+{
+  if (out->close)
+    fclose(out->file);
+  else
+    fflush(out->file);
+  pthread_mutex_destroy(&out->mutex);
+  free(out);
+}
+
+// serie de la configuración número config, que sim simula
+Pinterval_series interval_create(sim, config, window, by_inst, out)
+  Pcache_sim sim;
+  int config, window, by_inst;
+  Pinterval_output out;
+{
+  Pinterval_series series = (Pinterval_series)calloc(1, sizeof(interval_series));
+
+  series->sim = sim;
+  series->config = config;
+  series->window = window;
+  series->by_inst = by_inst;
+  series->next = window;
+  series->out = out;
+  return series;
+}
+/************************************************************/
+
+/************************************************************/
+// igual que sim_access_batch(), pero corta el bloque donde
+// termina cada ventana para escribir su renglón
+void interval_access_batch(series, types, addrs, n)
+  Pinterval_series series;
+  const unsigned char *types;
+  const sim_addr *addrs;
+  int n;
+{
+  long long warm = series->sim->warmup;
+  int start = 0, i;
+
+  // las referencias del calentamiento no forman parte de la serie
+  if (warm > 0) {
+    for (; start < n && warm > 0; start++)
+      warm -= types[start] <= TRACE_INST_LOAD;
+    sim_access_batch(series->sim, types, addrs, start);
+  }
+  for (i = start; i < n; i++) {
+    if (types[i] > TRACE_INST_LOAD)
+      continue;
+    series->refs++;
+    if (types[i] == TRACE_INST_LOAD)
+      series->insts++;
+    if ((series->by_inst ? series->insts : series->refs) == series->next) {
+      sim_access_batch(series->sim, types + start, addrs + start, i + 1 - start);
+      start = i + 1;
+      interval_emit(series);
+      series->next += series->window;
+    }
+  }
+  if (start < n)
+    sim_access_batch(series->sim, types + start, addrs + start, n - start);
+}
+
+// se llama después de sim_flush(): escribe la última ventana, que
+// puede ser más corta e incluye el flush, y lo que quede en el buffer
+void interval_finish(series)
+  Pinterval_series series;
+{
+  cache_stat inst, data;
+
+  sim_stats(series->sim, &inst, &data);
+  if ((series->by_inst ? series->insts : series->refs) != series->next - series->window ||
+      memcmp(&inst, &series->last_inst, sizeof(cache_stat)) ||
+      memcmp(&data, &series->last_data, sizeof(cache_stat)))
+    interval_emit(series);
+  interval_write(series);
+}
+
+void interval_destroy(series)
+  Pinterval_series series;
+{
+  free(series);
+}
+/************************************************************/
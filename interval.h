@@ -0,0 +1,47 @@
+/*
+ * interval.h
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+
+/* bytes de renglones que junta cada serie antes de escribirlos */
+#define INTERVAL_BUFFER (1 << 14)
+/* un renglón de la serie nunca pasa de esto */
+#define INTERVAL_LINE 512
+
+/* structure definitions */
+// archivo de la serie de tiempo que comparten todas las
+// configuraciones; el candado ordena las escrituras de los hilos
+// de -j, que siempre son renglones completos
+typedef struct interval_output_
+{
+  FILE *file;
+  int close;              /* TRUE if the file is ours to close */
+  pthread_mutex_t mutex;
+} interval_output, *Pinterval_output;
+
+// serie de tiempo de una configuración: cada window referencias
+// (o cada window fetches de instrucciones, con by_inst) escribe
+// lo que cambiaron las estadísticas de instrucciones y de datos
+typedef struct interval_series_
+{
+  Pcache_sim sim;
+  int config;                    /* row of the configuration in the results */
+  int window;
+  int by_inst;                   /* TRUE to count instruction fetches only */
+  long long refs, insts;         /* references and fetches simulated so far */
+  long long next;                /* value of the counter that ends the window */
+  int interval;                  /* windows already written */
+  cache_stat last_inst, last_data; /* statistics at the end of the last window */
+  Pinterval_output out;
+  int used;                      /* bytes in buffer */
+  char buffer[INTERVAL_BUFFER];
+} interval_series, *Pinterval_series;
+
+Pinterval_output open_interval_output();
+void close_interval_output();
+Pinterval_series interval_create();
+void interval_access_batch();
+void interval_finish();
+void interval_destroy();
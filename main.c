@@ -6,25 +6,147 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include "cache.h"
+#include "cachesim.h"
 #include "main.h"
+#include "trace.h"
+#include "sweep.h"
+#include "blockmap.h"
+#include "stackdist.h"
+#include "shard.h"
+#include "bench.h"
+#include "interval.h"
+#include "checkpoint.h"
+#include "profile.h"
+#include "heatmap.h"
 
-static FILE *traceFile;
+static Ptrace_reader traceFile;
 static int debug = FALSE;
 
+/* sweep configuration */
+// cada parámetro de la línea de comandos puede recibir una lista
+// de valores; se simula una configuración por cada combinación
+static param_list sweep[SWEEP_DIMS];
+static Pcache_sim *sims; // un simulador por configuración
+static int n_sims;
+static int n_threads = 1; // hilos que se reparten las configuraciones
+static unsigned seed = 0; // semilla de -seed, si se dio
+static int seed_given = FALSE;
+static int classify = FALSE; // -3c
+static int stack_sets = 0; // sets del modo de distancia de pila, 0 si no se usa
+static int n_parsers = 0; // hilos lectores de --pipeline, 0 si no se usa
+static int n_shards = 0; // hilos de --shards, 0 si no se usa
+static int bench_mode = FALSE; // --bench: trazas sintéticas en lugar de un archivo
+static bench_config bench;
+static int interval_window = 0; // -iv, 0 si no se piden intervalos
+static int interval_by_inst = FALSE; // -iu inst
+static char *interval_file = NULL; // -io, stderr si no se da
+static long long warmup = 0; // --warmup, referencias que no se cuentan
+static char *checkpoint_file = NULL; // --checkpoint
+static char *restore_file = NULL; // --restore
+static char *heatmap_prefix = NULL; // -hm, NULL si no se pide
+static int heatmap_bits = DEFAULT_HEATMAP_REGION_BITS; // -hr
+static int wbuf_rate = 0; // -wbr, 0 si no se da
+static Pinterval_output interval_out; // archivo de la serie de tiempo
+static Pinterval_series *series; // serie de tiempo de cada configuración
+
 int main(argc, argv) int argc;
 char **argv;
 {
+  // sub-modo de conversión: "sim --convert <texto> <binario>" solo
+  // traduce la traza al formato binario de trace.h y termina
+  if (argc == 4 && !strcmp(argv[1], "--convert"))
+  {
+    long long records = convert_trace(argv[2], argv[3]);
+    if (records < 0)
+      exit(-1);
+    printf("wrote %lld records to %s\n", records, argv[3]);
+    exit(0);
+  }
+
+  int i;
+
   // Lectura de los argumentos de la línea de comando y establece los parámetros de la memoria cache
   parse_args(argc, argv);
-  // Inicializa la memoria cache
-  init_cache();
-  // Pasa uno por uno las instrucciones de los archivos *.trace al simulador del cache
-  play_trace(traceFile);
-  // Imprime los resultados estadísticos de la simulación el cache
-  print_stats();
+  // Valida las configuraciones antes de leer la traza; en el modo de
+  // distancia de pila la asociatividad la decide play_trace_stack()
+  if (!stack_sets)
+  {
+    for (i = 0; i < n_sims; i++)
+      if (sim_check(sims[i]))
+        exit(-1);
+  }
+  // en el modo --bench no hay traza: se generan y se reporta el tiempo
+  if (bench_mode)
+  {
+    play_bench();
+    exit(0);
+  }
+  // con --checkpoint solo se simula el calentamiento
+  if (checkpoint_file)
+  {
+    play_checkpoint(traceFile);
+    exit(0);
+  }
+  if (interval_window)
+    start_intervals();
+#if defined(SIM_PROFILE)
+  profile_start_counters();
+#endif
+  // Pasa uno por uno las instrucciones de los archivos *.trace a todos los simuladores
+  if (stack_sets)
+    n_sims = play_trace_stack(traceFile, sims, n_sims, stack_sets, debug);
+  else if (n_shards)
+    play_trace_sharded(traceFile, sims, n_sims, n_shards, debug);
+  else if (n_threads > 1)
+    play_trace_parallel(traceFile, sims, series, n_sims, n_threads, debug);
+  else
+    play_trace(traceFile);
+#if defined(SIM_PROFILE)
+  profile_stop_counters();
+#endif
+  if (n_parsers)
+    print_trace_pipeline(traceFile);
+  if (interval_window)
+    stop_intervals();
+  if (heatmap_prefix && write_heatmaps(heatmap_prefix, sims, n_sims))
+    printf("error:  can not write the heat map %s\n", heatmap_prefix);
+#if defined(SIM_PROFILE)
+  print_run_profile(traceFile, debug);
+#endif
+  // si el descompresor falló la traza quedó incompleta y los
+  // resultados no valen: no se imprime ningún renglón
+  if (close_trace(traceFile))
+    exit(-1);
+  // Imprime la configuración y los resultados estadísticos de cada simulación, un renglón por configuración
+  for (i = 0; i < n_sims; i++)
+  {
+    sim_print_settings(sims[i]);
+    sim_print_stats(sims[i]);
+    sim_destroy(sims[i]);
+  }
+  free(sims);
 }
 
+/************************************************************/
+// banderas de parse_args() que van seguidas de un valor
+static const char *value_flags[] = {
+    "-bs", "-us", "-is", "-ds", "-a", "-wp", "-ap", "-rp", "-l2", "-l2a",
+    "-l3", "-l3a", "-ip", "-pf", "-pd", "-pl", "-vc", "-wbn", "-wbd", "-wbr",
+    "-seed", "-j", "-iv", "-iu", "-io", "-hm", "-hr", "--warmup",
+    "--checkpoint", "--restore", "--pipeline", "--shards", "--stack",
+    "-tg", "-tn", "-tf", "-ti", "-tw", "-ts", NULL};
+
+static int flag_takes_value(flag) char *flag;
+{
+  int i;
+
+  for (i = 0; value_flags[i] != NULL; i++)
+    if (!strcmp(flag, value_flags[i]))
+      return TRUE;
+  return FALSE;
+}
+/************************************************************/
+
 /************************************************************/
 /*
 Parsea los argumentos pasados en la línea de comando, estos
@@ -40,18 +162,74 @@ que se quiere simular. Entre los diferentes argumentos están:
 * -wt: establece la política de escritura del cache a write-through
 * -wa: establece la política de alocación de memoria a write-allocate
 * -nw: establece la política de alocación de memoria a no-write-allocate 
+* -wp <wb,wt>: simula ambas políticas de escritura
+* -ap <wa,nw>: simula ambas políticas de alocación
+* -rp <lru,...>: simula las políticas de reemplazo de la lista
+  (lru, fifo, random, plru, srrip, brrip, lfu)
+* -seed <n>: semilla de las políticas random y brrip
+* -l2 <size>, -l3 <size>: agrega un cache unificado L2 (y L3)
+  debajo de L1, con el mismo tamaño de bloque
+* -l2a <a>, -l3a <a>: asociatividad de L2 y L3 (default 8)
+* -ip <nine,incl,excl>: políticas de inclusión entre niveles
+* -pf <none,...>: simula los prefetchers de L1 de la lista
+  (none, nextline, stride, stream, tagged)
+* -pd <n>: grado del prefetcher, bloques pedidos por disparo
+* -pl <n>: latencia del prefetch en referencias; los bloques usados
+  antes de ese tiempo cuentan como prefetches tardíos
+* -vc <n>: agrega a cada L1 un victim cache de n bloques
+* -wbn <n>: agrega un buffer de escritura de n bloques para write
+  through, que combina las escrituras al mismo bloque
+* -wbd <eager,full>: políticas de vaciado del buffer: la memoria
+  escribe mientras haya algo (eager) o solo cuando está lleno (full)
+* -wbr <refs>: referencias que tarda la memoria en escribir una
+  entrada del buffer (default 4)
+* -3c: clasifica los fallos de L1 en compulsory, capacity y conflict
+* -j <n>: reparte las configuraciones del barrido entre n hilos
+* -iv <k>: escribe una serie de tiempo con lo que cambiaron las
+  estadísticas de instrucciones y datos en cada ventana de k
+  referencias (con -iu inst, de k fetches de instrucciones)
+* -io <archivo>: archivo CSV de la serie de tiempo (default stderr)
+* -hm <prefijo>: escribe el mapa de calor de L1 por set y por región
+  en <prefijo>-sets.csv y <prefijo>-regions.csv
+* -hr <bytes>: tamaño de las regiones de -hm (default 4096)
+* --warmup <n>: simula las primeras n referencias sin contarlas
+  en las estadísticas
+* --checkpoint <archivo>: simula solo el calentamiento de --warmup
+  y guarda el estado de los caches y la posición de la traza
+* --restore <archivo>: sigue la traza desde un checkpoint, con el
+  estado de los caches de cada configuración
+* --pipeline <n>: decodifica la traza en n hilos mientras se simula
+  y reporta en stderr el rendimiento de cada etapa
+* --shards <n>: reparte los sets de cada configuración entre n
+  hilos (potencia de dos); los resultados no cambian
+* --stack <sets>: calcula todo el barrido de tamaños con distancias
+  de pila LRU, con <sets> sets y asociatividad tamaño / (bs * sets)
+* --bench: en lugar de leer una traza, mide cada configuración con
+  trazas sintéticas y escribe los resultados en JSON. Va en primer
+  lugar y no lleva archivo de traza. Sus trazas se configuran con
+  -tg <seq,...> (generadores: seq, stride, random, zipf, chase,
+  loop), -tn <refs>, -tf <footprint>, -ti <% instrucciones>,
+  -tw <% escrituras> y -ts <stride>; -seed también es su semilla
+Los argumentos numéricos aceptan listas separadas por comas y
+rangos lo:hi de potencias de dos (-bs 4:4096 equivale a
+-bs 4,8,16,...,4096). Se crea un simulador por cada combinación
+de valores y todos se alimentan de una sola lectura de la traza.
 */
 void parse_args(argc, argv) int argc;
 char **argv;
 {
-  int arg_index, i, value;
+  int arg_index, i, split, last;
 
   // explica al usuario de la línea de comando como llamar al programa
   if (argc < 2)
   {
-    printf("usage:  sim <options> <trace file>\n");
+    printf("usage:  sim <options> <trace file, - for stdin>\n");
+    printf("        sim --convert <trace file> <binary trace file>\n");
+    printf("        sim --bench <options>\n");
     exit(-1);
   }
+  init_bench_config(&bench);
+  bench_mode = !strcmp(argv[1], "--bench");
 
   /* parse the command line arguments */
   // primero busca para ver si entre toda la línea de argumentos pasados
@@ -69,88 +247,429 @@ char **argv;
       printf("\t-wt: \t\tset write policy to write through\n");
       printf("\t-wa: \t\tset allocation policy to write allocate\n");
       printf("\t-nw: \t\tset allocation policy to no write allocate\n");
+      printf("\t-wp <wb,wt>: \tsweep write policies\n");
+      printf("\t-ap <wa,nw>: \tsweep allocation policies\n");
+      printf("\t-rp <lru,...>: \tsweep replacement policies: lru, fifo, random,\n");
+      printf("\t\t\tplru, srrip, brrip, lfu (default lru)\n");
+      printf("\t-seed <n>: \tseed of the random and brrip policies\n");
+      printf("\t-l2 <size>: \tadd a unified L2 cache below L1\n");
+      printf("\t-l2a <a>: \tset L2 associativity to <a> (default 8)\n");
+      printf("\t-l3 <size>: \tadd a unified L3 cache below L2\n");
+      printf("\t-l3a <a>: \tset L3 associativity to <a> (default 8)\n");
+      printf("\t-ip <nine,incl,excl>: sweep inclusion policies of L2/L3\n");
+      printf("\t\t\t(non-inclusive, inclusive, exclusive; default nine)\n");
+      printf("\t-pf <none,...>: sweep L1 prefetchers: none, nextline, stride,\n");
+      printf("\t\t\tstream, tagged (default none)\n");
+      printf("\t-pd <n>: \tset prefetch degree to <n> (default 1)\n");
+      printf("\t-pl <n>: \tset prefetch latency to <n> references (default 8)\n");
+      printf("\t-vc <n>: \tadd a victim cache of <n> blocks beside each L1\n");
+      printf("\t-wbn <n>: \tadd a write buffer of <n> blocks for write through\n");
+      printf("\t-wbd <eager,full>: sweep write buffer drain policies (default eager)\n");
+      printf("\t-wbr <refs>: \treferences memory takes to write one entry (default 4)\n");
+      printf("\t-3c: \t\tsplit L1 misses into compulsory, capacity and conflict\n");
+      printf("\t-j <n>: \tsimulate the sweep configurations on <n> threads\n");
+      printf("\t-iv <k>: \twrite statistics deltas every <k> references as CSV\n");
+      printf("\t-iu <refs,inst>: count the -iv window in references or in\n");
+      printf("\t\t\tinstruction fetches (default refs)\n");
+      printf("\t-io <file>: \twrite the -iv time series to <file> (default stderr)\n");
+      printf("\t-hm <prefix>: \twrite per-set and per-region L1 heat maps to\n");
+      printf("\t\t\t<prefix>-sets.csv and <prefix>-regions.csv\n");
+      printf("\t-hr <bytes>: \tregion size of the -hm heat map (default 4096)\n");
+      printf("\t--warmup <n>: \tsimulate <n> references before counting statistics\n");
+      printf("\t--checkpoint <file>: simulate only the warm-up and save the state\n");
+      printf("\t\t\tof every cache and the trace position to <file>\n");
+      printf("\t--restore <file>: continue the trace from a checkpoint\n");
+      printf("\t--pipeline <n>: parse the trace on <n> threads while simulating,\n");
+      printf("\t\t\tand report the throughput of each stage on stderr\n");
+      printf("\t--shards <n>: \tsplit the sets of every configuration among <n> threads\n");
+      printf("\t--stack <sets>: compute the whole size sweep from LRU stack distances,\n");
+      printf("\t\t\twith <sets> sets and associativity size / (bs * sets)\n");
       printf("\t--debug: \t\tset info prints for debugging\n");
+      printf("\n\t--bench <options>: time every configuration on synthetic traces, as JSON\n");
+      printf("\t-tg <seq,...>: \tgenerators: seq, stride, random, zipf, chase, loop\n");
+      printf("\t-tn <n>: \treferences per trace (default %d)\n", BENCH_REFS);
+      printf("\t-tf <bytes>: \tdata footprint, a power of two (default %d)\n", BENCH_FOOTPRINT);
+      printf("\t-ti <pct>: \tpercent of instruction fetches (default %d)\n", BENCH_INST_PCT);
+      printf("\t-tw <pct>: \tpercent of stores among data references (default %d)\n", BENCH_STORE_PCT);
+      printf("\t-ts <bytes>: \tstride of the stride generator (default %d)\n", BENCH_STRIDE);
+      printf("\n\tnumeric values accept lists (4,8,16) and power of two ranges (4:4096);\n");
+      printf("\tone CSV row is printed for every combination of values\n");
+      printf("\n\t--convert <in> <out>: \twrite text trace <in> as binary trace <out>\n");
       exit(0);
     }
 
-  arg_index = 1;
+  split = FALSE;
+  arg_index = bench_mode ? 2 : 1;
+  last = bench_mode ? argc : argc - 1;
   // ojo: vamos hasta argc - 1 porque el úlimo elemento debe ser el archivo *.trace
-  while (arg_index != argc - 1)
+  // (en el modo --bench no hay archivo)
+  while (arg_index < last)
   {
+    // en el modo --bench la última bandera puede quedarse sin valor
+    if (flag_takes_value(argv[arg_index]) && arg_index + 1 >= argc)
+    {
+      printf("error:  %s needs a value\n", argv[arg_index]);
+      printf("usage:  sim --bench <options>\n");
+      exit(-1);
+    }
 
     /* set the cache simulator parameters */
 
     if (!strcmp(argv[arg_index], "-bs"))
     {
-      value = atoi(argv[arg_index + 1]);
-      set_cache_param(CACHE_PARAM_BLOCK_SIZE, value);
+      parse_param_list(&sweep[SWEEP_BLOCK], CACHE_PARAM_BLOCK_SIZE, argv[arg_index + 1]);
       arg_index += 2;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-us"))
     {
-      value = atoi(argv[arg_index + 1]);
-      set_cache_param(CACHE_PARAM_USIZE, value);
+      parse_param_list(&sweep[SWEEP_USIZE], CACHE_PARAM_USIZE, argv[arg_index + 1]);
+      split = FALSE;
       arg_index += 2;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-is"))
     {
-      value = atoi(argv[arg_index + 1]);
-      set_cache_param(CACHE_PARAM_ISIZE, value);
+      parse_param_list(&sweep[SWEEP_ISIZE], CACHE_PARAM_ISIZE, argv[arg_index + 1]);
+      split = TRUE;
       arg_index += 2;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-ds"))
     {
-      value = atoi(argv[arg_index + 1]);
-      set_cache_param(CACHE_PARAM_DSIZE, value);
+      parse_param_list(&sweep[SWEEP_DSIZE], CACHE_PARAM_DSIZE, argv[arg_index + 1]);
+      split = TRUE;
       arg_index += 2;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-a"))
     {
-      value = atoi(argv[arg_index + 1]);
-      set_cache_param(CACHE_PARAM_ASSOC, value);
+      parse_param_list(&sweep[SWEEP_ASSOC], CACHE_PARAM_ASSOC, argv[arg_index + 1]);
       arg_index += 2;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-wb"))
     {
-      set_cache_param(CACHE_PARAM_WRITEBACK, value);
+      sweep[SWEEP_WRITE].n = 0;
+      add_param_value(&sweep[SWEEP_WRITE], CACHE_PARAM_WRITEBACK, 0);
       arg_index += 1;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-wt"))
     {
-      set_cache_param(CACHE_PARAM_WRITETHROUGH, value);
+      sweep[SWEEP_WRITE].n = 0;
+      add_param_value(&sweep[SWEEP_WRITE], CACHE_PARAM_WRITETHROUGH, 0);
       arg_index += 1;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-wa"))
     {
-      set_cache_param(CACHE_PARAM_WRITEALLOC, value);
+      sweep[SWEEP_ALLOC].n = 0;
+      add_param_value(&sweep[SWEEP_ALLOC], CACHE_PARAM_WRITEALLOC, 0);
       arg_index += 1;
       continue;
     }
 
     if (!strcmp(argv[arg_index], "-nw"))
     {
-      set_cache_param(CACHE_PARAM_NOWRITEALLOC, value);
+      sweep[SWEEP_ALLOC].n = 0;
+      add_param_value(&sweep[SWEEP_ALLOC], CACHE_PARAM_NOWRITEALLOC, 0);
+      arg_index += 1;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-wp"))
+    {
+      parse_write_list(&sweep[SWEEP_WRITE], argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-ap"))
+    {
+      parse_alloc_list(&sweep[SWEEP_ALLOC], argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-rp"))
+    {
+      parse_replacement_list(&sweep[SWEEP_REPLACE], argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-l2"))
+    {
+      parse_param_list(&sweep[SWEEP_L2SIZE], CACHE_PARAM_L2_SIZE, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-l2a"))
+    {
+      parse_param_list(&sweep[SWEEP_L2ASSOC], CACHE_PARAM_L2_ASSOC, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-l3"))
+    {
+      parse_param_list(&sweep[SWEEP_L3SIZE], CACHE_PARAM_L3_SIZE, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-l3a"))
+    {
+      parse_param_list(&sweep[SWEEP_L3ASSOC], CACHE_PARAM_L3_ASSOC, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-ip"))
+    {
+      parse_inclusion_list(&sweep[SWEEP_INCLUSION], argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-pf"))
+    {
+      parse_prefetcher_list(&sweep[SWEEP_PREFETCH], argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-pd"))
+    {
+      parse_param_list(&sweep[SWEEP_PFDEGREE], CACHE_PARAM_PREFETCH_DEGREE, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-pl"))
+    {
+      parse_param_list(&sweep[SWEEP_PFLATENCY], CACHE_PARAM_PREFETCH_LATENCY, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-vc"))
+    {
+      parse_param_list(&sweep[SWEEP_VICTIM], CACHE_PARAM_VICTIM_ENTRIES, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-wbn"))
+    {
+      parse_param_list(&sweep[SWEEP_WBUF], CACHE_PARAM_WRITE_BUFFER, argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-wbd"))
+    {
+      parse_drain_list(&sweep[SWEEP_WBDRAIN], argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-wbr"))
+    {
+      wbuf_rate = atoi(argv[arg_index + 1]);
+      if (wbuf_rate < 1)
+      {
+        printf("error:  the write buffer rate must be at least one reference\n");
+        exit(-1);
+      }
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-3c"))
+    {
+      classify = TRUE;
       arg_index += 1;
       continue;
     }
 
+    if (!strcmp(argv[arg_index], "-seed"))
+    {
+      seed = (unsigned)strtoul(argv[arg_index + 1], NULL, 10);
+      seed_given = TRUE;
+      bench.seed = seed;
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-j"))
+    {
+      n_threads = atoi(argv[arg_index + 1]);
+      if (n_threads < 1)
+        n_threads = 1;
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-iv"))
+    {
+      interval_window = atoi(argv[arg_index + 1]);
+      if (interval_window < 1)
+      {
+        printf("error:  the interval must be at least one reference\n");
+        exit(-1);
+      }
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-iu"))
+    {
+      if (!strcmp(argv[arg_index + 1], "inst"))
+        interval_by_inst = TRUE;
+      else if (!strcmp(argv[arg_index + 1], "refs"))
+        interval_by_inst = FALSE;
+      else
+      {
+        printf("error:  unrecognized interval unit %s\n", argv[arg_index + 1]);
+        exit(-1);
+      }
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-io"))
+    {
+      interval_file = argv[arg_index + 1];
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-hm"))
+    {
+      heatmap_prefix = argv[arg_index + 1];
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-hr"))
+    {
+      unsigned long long region = strtoull(argv[arg_index + 1], NULL, 10);
+      if (region < 2 || (region & (region - 1)))
+      {
+        printf("error:  the heat map region must be a power of two of at least 2 bytes\n");
+        exit(-1);
+      }
+      for (heatmap_bits = 0; region > 1; region >>= 1)
+        heatmap_bits++;
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "--warmup"))
+    {
+      warmup = strtoll(argv[arg_index + 1], NULL, 10);
+      if (warmup < 0)
+        warmup = 0;
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "--checkpoint"))
+    {
+      checkpoint_file = argv[arg_index + 1];
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "--restore"))
+    {
+      restore_file = argv[arg_index + 1];
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "--pipeline"))
+    {
+      n_parsers = atoi(argv[arg_index + 1]);
+      if (n_parsers < 1)
+        n_parsers = 1;
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "--shards"))
+    {
+      n_shards = atoi(argv[arg_index + 1]);
+      if (n_shards < 1 || n_shards > MAX_SHARDS || (n_shards & (n_shards - 1)))
+      {
+        printf("error:  --shards needs a power of two from 1 to %d\n", MAX_SHARDS);
+        exit(-1);
+      }
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "--stack"))
+    {
+      stack_sets = atoi(argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-tg"))
+    {
+      parse_generator_list(argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-tn"))
+    {
+      bench.refs = atoi(argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-tf"))
+    {
+      bench.footprint = (unsigned)strtoul(argv[arg_index + 1], NULL, 10);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-ti"))
+    {
+      bench.inst_pct = atoi(argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-tw"))
+    {
+      bench.store_pct = atoi(argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
+    if (!strcmp(argv[arg_index], "-ts"))
+    {
+      bench.stride = atoi(argv[arg_index + 1]);
+      arg_index += 2;
+      continue;
+    }
+
     if (!strcmp(argv[arg_index], "--debug"))
     {
-      set_cache_param(CACHE_PARAM_DEBUG, value);
       debug = TRUE;
       arg_index += 1;
       continue;
@@ -160,7 +679,54 @@ char **argv;
     exit(-1);
   }
 
-  dump_settings();
+  if (n_shards && (stack_sets || n_threads > 1))
+  {
+    printf("error:  --shards cannot be combined with -j or --stack\n");
+    exit(-1);
+  }
+  if (interval_window && (stack_sets || n_shards || bench_mode))
+  {
+    printf("error:  -iv cannot be combined with --shards, --stack or --bench\n");
+    exit(-1);
+  }
+  if (heatmap_prefix && (stack_sets || n_shards || bench_mode))
+  {
+    printf("error:  -hm cannot be combined with --shards, --stack or --bench\n");
+    exit(-1);
+  }
+  // los shards y las distancias de pila no ven la traza completa
+  // por configuración, ni tienen un estado que guardar
+  if ((warmup || restore_file) && (stack_sets || n_shards || bench_mode))
+  {
+    printf("error:  --warmup and --restore cannot be combined with --shards, --stack or --bench\n");
+    exit(-1);
+  }
+  if (checkpoint_file && (!warmup || restore_file || n_threads > 1 || interval_window))
+  {
+    printf("error:  --checkpoint needs --warmup, and no --restore, -j or -iv\n");
+    exit(-1);
+  }
+
+  // igual que con un solo simulador, el último de -us o -is/-ds
+  // decide si el cache es unificado o dividido; los tamaños del
+  // otro modo no forman parte del barrido
+  if (split)
+    sweep[SWEEP_USIZE].n = 0;
+  else
+    sweep[SWEEP_ISIZE].n = sweep[SWEEP_DSIZE].n = 0;
+  build_sweep();
+
+  if (bench_mode)
+  {
+    if (stack_sets || n_shards || n_threads > 1 || n_parsers)
+    {
+      printf("error:  --bench times one configuration at a time, without -j, --shards, --pipeline or --stack\n");
+      exit(-1);
+    }
+    if (check_bench_config(&bench))
+      exit(-1);
+    return;
+  }
 
   /* open the trace file */
   // cuando sale del ciclo while, arg_index es el índice
@@ -168,7 +734,18 @@ char **argv;
   // *.trace, recordar que traceFile esta declarado de forma
   // global por lo que no hace falta regresar nada como
   // resultado de la función
-  traceFile = fopen(argv[arg_index], "r");
+  traceFile = open_trace(argv[arg_index]);
+  if (traceFile == NULL)
+  {
+    printf("error:  can not open trace file %s\n", argv[arg_index]);
+    exit(-1);
+  }
+  // el checkpoint se restaura antes de repartir la traza entre
+  // los hilos de --pipeline, que empiezan donde quedó
+  if (restore_file && read_checkpoint(restore_file, sims, n_sims, traceFile))
+    exit(-1);
+  if (n_parsers)
+    pipeline_trace(traceFile, n_parsers);
 
   return;
 }
@@ -177,64 +754,409 @@ char **argv;
 /************************************************************/
 
 void play_trace(inFile)
-    FILE *inFile;
+    Ptrace_reader inFile;
 {
-  unsigned addr, data, access_type;
-  int num_inst = 0;
+  static unsigned char types[TRACE_BLOCK];
+  static sim_addr addrs[TRACE_BLOCK];
+  long long num_inst = 0;
+  int n, consumed, i;
 
-  // la función read_trace_element regresa 0 cuando se alcanza
-  // el final (EOF) del archivo leído. Por eso se puede utilizar
-  // al interior de un while
-  while (read_trace_element(inFile, &access_type, &addr))
+  // la traza se lee por bloques de TRACE_BLOCK referencias, que se
+  // pasan completos a cada simulador. read_trace_block ya descarta
+  // (y reporta) las referencias con tipos desconocidos, los valores
+  // de access type están definidos en cachesim.h. consumed es 0
+  // cuando se alcanza el final (EOF) del archivo leído
+  for (;;)
   {
+    n = read_trace_block(inFile, types, addrs, TRACE_BLOCK, &consumed);
+    if (!consumed)
+      break;
+
+    for (i = 0; i < n_sims; i++)
+      if (series)
+        interval_access_batch(series[i], types, addrs, n);
+      else
+        sim_access_batch(sims[i], types, addrs, n);
 
-    // los valors de access type están definidos en main.h
-    // estas instrucciones se ejecutan por cada línea de los
-    // archivos *.trace
-    switch (access_type)
+    for (; consumed > 0; consumed--)
     {
-    case TRACE_DATA_LOAD:
-    case TRACE_DATA_STORE:
-    case TRACE_INST_LOAD:
-      perform_access(addr, access_type);
+      num_inst++;
+      if (!(num_inst % PRINT_INTERVAL) && debug)
+        printf("processed %lld references\n", num_inst);
+    }
+  }
+
+  for (i = 0; i < n_sims; i++)
+  {
+    sim_flush(sims[i]);
+    if (series)
+      interval_finish(series[i]);
+  }
+}
+/************************************************************/
+// --checkpoint: simula exactamente las referencias del
+// calentamiento (la lectura se detiene en la última) y guarda el
+// estado de todos los simuladores y la posición de la traza
+void play_checkpoint(inFile)
+    Ptrace_reader inFile;
+{
+  static unsigned char types[TRACE_BLOCK];
+  static sim_addr addrs[TRACE_BLOCK];
+  long long refs = 0, records = 0;
+  int n, consumed, i;
+
+  while (refs < warmup)
+  {
+    n = read_trace_block(inFile, types, addrs,
+                         warmup - refs < TRACE_BLOCK ? (int)(warmup - refs) : TRACE_BLOCK, &consumed);
+    if (!consumed)
       break;
+    for (i = 0; i < n_sims; i++)
+      sim_access_batch(sims[i], types, addrs, n);
+    refs += n;
+    records += consumed;
+  }
+  if (refs < warmup)
+  {
+    printf("error:  the trace ended after %lld references, before the end of the warm-up\n", refs);
+    exit(-1);
+  }
+  if (write_checkpoint(checkpoint_file, sims, n_sims, inFile, records))
+    exit(-1);
+  // un checkpoint de una traza incompleta no se podría restaurar
+  if (close_trace(inFile))
+  {
+    remove(checkpoint_file);
+    exit(-1);
+  }
+  printf("wrote checkpoint of %d configurations after %lld references to %s\n", n_sims, refs, checkpoint_file);
+}
+/************************************************************/
 
-    default:
-      printf("skipping access, unknown type(%d)\n", access_type);
-    }
+/************************************************************/
+// abre el archivo de -io y crea la serie de tiempo de cada
+// configuración; config es el número de su renglón de resultados
+void start_intervals()
+{
+  int i;
+
+  interval_out = open_interval_output(interval_file);
+  if (interval_out == NULL)
+  {
+    printf("error:  can not open interval file %s\n", interval_file);
+    exit(-1);
+  }
+  series = (Pinterval_series *)malloc(sizeof(Pinterval_series) * n_sims);
+  for (i = 0; i < n_sims; i++)
+    series[i] = interval_create(sims[i], i, interval_window, interval_by_inst, interval_out);
+}
+
+void stop_intervals()
+{
+  int i;
+
+  for (i = 0; i < n_sims; i++)
+    interval_destroy(series[i]);
+  free(series);
+  series = NULL;
+  close_interval_output(interval_out);
+}
+/************************************************************/
+
+/************************************************************/
+// modo --bench: genera cada traza sintética una vez y la simula
+// con cada configuración del barrido, una a la vez para medirlas
+// por separado. Los simuladores de build_sweep() ya quedan usados
+// después de una traza, así que el barrido se vuelve a crear
+void play_bench()
+{
+  unsigned char *types = (unsigned char *)malloc(bench.refs);
+  sim_addr *addrs = (sim_addr *)malloc(sizeof(sim_addr) * bench.refs);
+  int g, i, first = TRUE;
 
-    num_inst++;
-    if (!(num_inst % PRINT_INTERVAL) && debug)
-      printf("processed %d references\n", num_inst);
+  bench_print_header(&bench);
+  for (g = 0; g < BENCH_GENERATORS; g++)
+  {
+    if (!(bench.generators & (1 << g)))
+      continue;
+    bench_generate(&bench, g, types, addrs);
+    for (i = 0; i < n_sims; i++)
+    {
+      bench_run(&bench, g, types, addrs, sims[i], first);
+      sim_destroy(sims[i]);
+      first = FALSE;
+    }
+    free(sims);
+    build_sweep();
   }
+  bench_print_footer();
+
+  for (i = 0; i < n_sims; i++)
+    sim_destroy(sims[i]);
+  free(sims);
+  free(types);
+  free(addrs);
+}
+/************************************************************/
 
-  flush();
+/************************************************************/
+// agrega un par (parámetro, valor) a la lista de valores de
+// una dimensión del barrido
+void add_param_value(list, param, value)
+    Pparam_list list;
+int param, value;
+{
+  if (list->n == MAX_PARAM_VALUES)
+  {
+    printf("error:  more than %d values for one parameter\n", MAX_PARAM_VALUES);
+    exit(-1);
+  }
+  list->params[list->n] = param;
+  list->values[list->n] = value;
+  list->n++;
 }
 /************************************************************/
 
 /************************************************************/
-// esta función lee una línea a la vez de los archivos *.trace
-int read_trace_element(inFile, access_type, addr)
-    FILE *inFile;
-unsigned *access_type, *addr;
+// parsea el valor de un argumento numérico. Puede ser un solo
+// número, una lista separada por comas o rangos lo:hi que
+// se expanden a todas las potencias de dos entre lo y hi,
+// por ejemplo "1,4:16" se vuelve 1, 4, 8, 16
+void parse_param_list(list, param, text)
+    Pparam_list list;
+int param;
+char *text;
 {
-  int result;
-  char c;
+  int lo, hi, value;
+  char *end;
 
-  // la función fscanf asigna el resultado de %u a access_type
-  // %x a addr y %c a c. El formato de lo que está leyendo es
-  // "2 408ed4" por lo que el %c corresponde a \n o espacios
-  // que se eliminan en el ciclo while interno
-  result = fscanf(inFile, "%u %x%c", access_type, addr, &c);
-  while (c != '\n')
+  list->n = 0;
+  for (;;)
   {
-    result = fscanf(inFile, "%c", &c);
-    if (result == EOF)
+    lo = (int)strtol(text, &end, 10);
+    if (*end == ':')
+    {
+      hi = (int)strtol(end + 1, &end, 10);
+      if (lo <= 0 || hi < lo)
+      {
+        printf("error:  bad range %d:%d\n", lo, hi);
+        exit(-1);
+      }
+      for (value = lo; value <= hi && value > 0; value *= 2)
+        add_param_value(list, param, value);
+    }
+    else
+      add_param_value(list, param, lo);
+
+    if (*end != ',')
       break;
+    text = end + 1;
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// parsea la lista de políticas de escritura de -wp (wb, wt)
+void parse_write_list(list, text)
+    Pparam_list list;
+char *text;
+{
+  char *item;
+
+  list->n = 0;
+  for (item = strtok(text, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    if (!strcmp(item, "wb"))
+      add_param_value(list, CACHE_PARAM_WRITEBACK, 0);
+    else if (!strcmp(item, "wt"))
+      add_param_value(list, CACHE_PARAM_WRITETHROUGH, 0);
+    else
+    {
+      printf("error:  unrecognized policy %s\n", item);
+      exit(-1);
+    }
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// parsea la lista de políticas de alocación de -ap (wa, nw)
+void parse_alloc_list(list, text)
+    Pparam_list list;
+char *text;
+{
+  char *item;
+
+  list->n = 0;
+  for (item = strtok(text, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    if (!strcmp(item, "wa"))
+      add_param_value(list, CACHE_PARAM_WRITEALLOC, 0);
+    else if (!strcmp(item, "nw"))
+      add_param_value(list, CACHE_PARAM_NOWRITEALLOC, 0);
+    else
+    {
+      printf("error:  unrecognized policy %s\n", item);
+      exit(-1);
+    }
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// parsea la lista de políticas de inclusión de -ip (nine, incl, excl)
+void parse_inclusion_list(list, text)
+    Pparam_list list;
+char *text;
+{
+  char *item;
+  int policy;
+
+  list->n = 0;
+  for (item = strtok(text, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    policy = inclusion_from_name(item);
+    if (policy < 0)
+    {
+      printf("error:  unrecognized policy %s\n", item);
+      exit(-1);
+    }
+    add_param_value(list, CACHE_PARAM_INCLUSION, policy);
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// parsea la lista de políticas de reemplazo de -rp
+void parse_replacement_list(list, text)
+    Pparam_list list;
+char *text;
+{
+  char *item;
+  int policy;
+
+  list->n = 0;
+  for (item = strtok(text, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    policy = replacement_from_name(item);
+    if (policy < 0)
+    {
+      printf("error:  unrecognized replacement policy %s\n", item);
+      exit(-1);
+    }
+    add_param_value(list, CACHE_PARAM_REPLACEMENT, policy);
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// parsea la lista de prefetchers de -pf
+void parse_prefetcher_list(list, text)
+    Pparam_list list;
+char *text;
+{
+  char *item;
+  int kind;
+
+  list->n = 0;
+  for (item = strtok(text, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    kind = prefetcher_from_name(item);
+    if (kind < 0)
+    {
+      printf("error:  unrecognized prefetcher %s\n", item);
+      exit(-1);
+    }
+    add_param_value(list, CACHE_PARAM_PREFETCHER, kind);
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// parsea la lista de políticas de vaciado de -wbd
+void parse_drain_list(list, text)
+    Pparam_list list;
+char *text;
+{
+  char *item;
+  int policy;
+
+  list->n = 0;
+  for (item = strtok(text, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    policy = drain_from_name(item);
+    if (policy < 0)
+    {
+      printf("error:  unrecognized drain policy %s\n", item);
+      exit(-1);
+    }
+    add_param_value(list, CACHE_PARAM_WB_DRAIN, policy);
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// parsea la lista de generadores de -tg
+void parse_generator_list(text)
+    char *text;
+{
+  char *item;
+  int g;
+
+  bench.generators = 0;
+  for (item = strtok(text, ","); item != NULL; item = strtok(NULL, ","))
+  {
+    g = bench_from_name(item);
+    if (g < 0)
+    {
+      printf("error:  unrecognized trace generator %s\n", item);
+      exit(-1);
+    }
+    bench.generators |= 1 << g;
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// crea un simulador por cada combinación de valores del barrido.
+// Las configuraciones se enumeran como un número en base mixta:
+// la dimensión SWEEP_* con el número más alto (ver main.h) es
+// la que cambia más rápido. Los parámetros que no se dieron
+// conservan su valor default.
+void build_sweep()
+{
+  int d, k, i, rest;
+
+  n_sims = 1;
+  for (d = 0; d < SWEEP_DIMS; d++)
+    if (sweep[d].n)
+      n_sims *= sweep[d].n;
+
+  sims = (Pcache_sim *)malloc(sizeof(Pcache_sim) * n_sims);
+  for (k = 0; k < n_sims; k++)
+  {
+    sims[k] = sim_create();
+    if (debug)
+      sim_configure(sims[k], CACHE_PARAM_DEBUG, 0);
+    if (seed_given)
+      sim_configure(sims[k], CACHE_PARAM_SEED, seed);
+    if (classify)
+      sim_configure(sims[k], CACHE_PARAM_CLASSIFY, TRUE);
+    if (heatmap_prefix)
+      sim_configure(sims[k], CACHE_PARAM_HEATMAP, heatmap_bits);
+    if (wbuf_rate)
+      sim_configure(sims[k], CACHE_PARAM_WB_RATE, wbuf_rate);
+    if (warmup)
+      sim_warmup(sims[k], warmup);
+    rest = k;
+    for (d = SWEEP_DIMS - 1; d >= 0; d--)
+    {
+      if (!sweep[d].n)
+        continue;
+      i = rest % sweep[d].n;
+      rest /= sweep[d].n;
+      sim_configure(sims[k], sweep[d].params[i], sweep[d].values[i]);
+    }
   }
-  if (result != EOF)
-    return (1);
-  else
-    return (0);
 }
 /************************************************************/
@@ -3,12 +3,59 @@
  * main.h
  */
 
-#define TRACE_DATA_LOAD 0
-#define TRACE_DATA_STORE 1
-#define TRACE_INST_LOAD 2
+#define TRUE 1
+#define FALSE 0
 
 #define PRINT_INTERVAL 100000
 
+/* dimensiones del barrido de configuraciones, de la más
+ * externa a la más interna en el orden de los renglones */
+#define SWEEP_USIZE 0
+#define SWEEP_ISIZE 1
+#define SWEEP_DSIZE 2
+#define SWEEP_ASSOC 3
+#define SWEEP_BLOCK 4
+#define SWEEP_WRITE 5
+#define SWEEP_ALLOC 6
+#define SWEEP_REPLACE 7
+#define SWEEP_L2SIZE 8
+#define SWEEP_L2ASSOC 9
+#define SWEEP_L3SIZE 10
+#define SWEEP_L3ASSOC 11
+#define SWEEP_INCLUSION 12
+#define SWEEP_PREFETCH 13
+#define SWEEP_PFDEGREE 14
+#define SWEEP_PFLATENCY 15
+#define SWEEP_VICTIM 16
+#define SWEEP_WBUF 17
+#define SWEEP_WBDRAIN 18
+#define SWEEP_DIMS 19
+
+#define MAX_PARAM_VALUES 64
+
+/* structure definitions */
+// valores que toma un parámetro en el barrido: cada entrada
+// es una llamada a set_cache_param(sim, params[i], values[i])
+typedef struct param_list_
+{
+  int n;                        /* number of values, 0 if not given */
+  int params[MAX_PARAM_VALUES]; /* CACHE_PARAM_* constant */
+  int values[MAX_PARAM_VALUES]; /* value for set_cache_param() */
+} param_list, *Pparam_list;
+
 void parse_args();
 void play_trace();
-int read_trace_element();
+void play_bench();
+void play_checkpoint();
+void start_intervals();
+void stop_intervals();
+void add_param_value();
+void parse_param_list();
+void parse_write_list();
+void parse_alloc_list();
+void parse_inclusion_list();
+void parse_replacement_list();
+void parse_prefetcher_list();
+void parse_drain_list();
+void parse_generator_list();
+void build_sweep();
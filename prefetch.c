@@ -0,0 +1,345 @@
+/*
+ * prefetch.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+#include "hierarchy.h"
+#include "prefetch.h"
+#include "victim.h"
+
+/************************************************************/
+// prefetchers de los caches L1. Cada cache L1 tiene el suyo y
+// todos reportan a sim->prefetch_stats:
+//   issued:    bloques que trajo el prefetcher
+//   useful:    bloques traídos que después se referenciaron
+//   late:      de los útiles, los que se referenciaron antes de
+//              prefetch_latency referencias desde que se pidieron
+//   polluting: fallos a bloques que un prefetch sacó del cache
+//   fetches:   palabras traídas por el prefetcher; no se suman a
+//              demand_fetches
+// Los bloques se identifican por su número (dirección >> offset).
+/************************************************************/
+
+/* names of the prefetchers, indexed by PREFETCH_* */
+static const char *prefetcher_names[PREFETCHERS] = {
+  "NONE", "NEXTLINE", "STRIDE", "STREAM", "TAGGED"
+};
+
+/* names accepted by prefetcher_from_name(), same order */
+static const char *prefetcher_options[PREFETCHERS] = {
+  "none", "nextline", "stride", "stream", "tagged"
+};
+
+const char *prefetcher_name(int kind)
+{
+  return prefetcher_names[kind];
+}
+
+/* prefetcher of a -pf option value, -1 if unknown */
+int prefetcher_from_name(const char *name)
+{
+  for (int kind = 0; kind < PREFETCHERS; kind++) {
+    if (!strcmp(name, prefetcher_options[kind])) {
+      return kind;
+    }
+  }
+  return -1;
+}
+
+/* number of the reference being simulated, for late prefetches */
+static unsigned prefetch_now(Pcache_sim sim)
+{
+  // las diferencias entre tiempos de 32 bits siguen bien al dar la vuelta
+  return (unsigned)(sim->clock_base + sim->cache_stat_inst.accesses + sim->cache_stat_data.accesses);
+}
+
+/* slot of a block in the filter of blocks evicted by prefetches */
+static int filter_slot(sim_addr block)
+{
+  return (BLOCK_HASH(block) >> 16) % PREFETCH_FILTER;
+}
+/************************************************************/
+
+/************************************************************/
+/* gives an L1 cache its prefetcher, or none */
+void init_prefetcher(Pcache ptr_cache, int kind, int degree)
+{
+  ptr_cache->prefetcher = NULL;
+  if (kind == PREFETCH_NONE) {
+    return;
+  }
+  ptr_cache->prefetcher = (Pprefetcher)calloc(1, sizeof(prefetcher));
+  ptr_cache->prefetcher->kind = kind;
+  ptr_cache->prefetcher->degree = degree;
+}
+/************************************************************/
+
+/************************************************************/
+// trae un bloque al cache antes de que se pida. Si ya está no
+// hace nada; si saca una línea que no era de otro prefetch, la
+// recuerda para contar los fallos que eso provoque
+static void prefetch_block(Pcache_sim sim, Pcache ptr_cache, sim_addr block)
+{
+  sim_addr addr = block << ptr_cache->index_mask_offset;
+  int index = getLineIndex(ptr_cache, addr);
+  sim_addr tag = getTag(ptr_cache, addr);
+  insertion_response response;
+  Pcache_line line;
+
+  if (get_line_way(ptr_cache, index, tag) >= 0 || victim_contains(ptr_cache, block)) {
+    return;
+  }
+
+  response = full_insert(ptr_cache, index, tag);
+  victim_insert(sim, ptr_cache, index, &response);
+  line = &ptr_cache->lines[index * ptr_cache->associativity + response.way];
+  line->prefetched = TRUE;
+  line->prefetch_time = prefetch_now(sim);
+  sim->prefetch_stats.issued++;
+  sim->prefetch_stats.fetches += sim->words_per_block;
+  sim->prefetch_stats.fetch_bytes += sim->words_per_block * WORD_SIZE;
+
+  if (response.replacement) {
+    sim_addr victim = block_address(ptr_cache, index, response.victim_tag) >> ptr_cache->index_mask_offset;
+    // los datos sucios se escriben igual que en un fallo normal
+    COUNT_COPY_BACK(&sim->cache_stat_data, response.dirty_bit * sim->words_per_block);
+    if (!response.victim_prefetched) {
+      ptr_cache->prefetcher->filter[filter_slot(victim)] = victim + 1;
+    }
+  }
+  if (sim->n_lower) {
+    hierarchy_fill(sim, ptr_cache, index, tag, response, 1);
+  }
+}
+
+// agrega al final de un stream buffer el bloque que sigue
+static void stream_append(Pcache_sim sim, Pcache ptr_cache, stream_buffer *sb, sim_addr block)
+{
+  int i = sb->count++;
+
+  sb->blocks[i] = block;
+  sb->dirty[i] = sim->n_lower ? hierarchy_read(sim, block << ptr_cache->index_mask_offset) : FALSE;
+  sb->times[i] = prefetch_now(sim);
+  sim->prefetch_stats.issued++;
+  sim->prefetch_stats.fetches += sim->words_per_block;
+  sim->prefetch_stats.fetch_bytes += sim->words_per_block * WORD_SIZE;
+}
+
+// descarta el contenido de un stream buffer; los bloques sucios
+// (solo en jerarquías exclusivas) regresan a L2
+static void stream_discard(Pcache_sim sim, Pcache ptr_cache, stream_buffer *sb)
+{
+  for (int i = 0; i < sb->count; i++) {
+    if (sb->dirty[i]) {
+      lower_writeback(sim, 0, sb->blocks[i] << ptr_cache->index_mask_offset);
+    }
+  }
+  sb->count = 0;
+}
+/************************************************************/
+
+/************************************************************/
+// un fallo de demanda en ptr_cache. Cuenta si lo causó un prefetch
+// y, con stream buffers, saca el bloque del buffer que lo tenga
+// (solo si el fallo va a traer el bloque al cache, allocate).
+// Regresa PREFETCH_NOT_BUFFERED si el bloque se tiene que pedir
+int prefetch_miss(Pcache_sim sim, Pcache ptr_cache, int index, sim_addr tag, int allocate)
+{
+  Pprefetcher pf = ptr_cache->prefetcher;
+  sim_addr block = block_address(ptr_cache, index, tag) >> ptr_cache->index_mask_offset;
+  int slot = filter_slot(block);
+
+  if (pf->filter[slot] == block + 1) {
+    sim->prefetch_stats.polluting++;
+    pf->filter[slot] = 0;
+  }
+  if (pf->kind != PREFETCH_STREAM || !allocate) {
+    return PREFETCH_NOT_BUFFERED;
+  }
+
+  for (int b = 0; b < PREFETCH_STREAMS; b++) {
+    stream_buffer *sb = &pf->streams[b];
+    for (int i = 0; i < sb->count; i++) {
+      if (sb->blocks[i] != block) {
+        continue;
+      }
+      int dirty = sb->dirty[i];
+      sim->prefetch_stats.useful++;
+      if (prefetch_now(sim) - sb->times[i] < (unsigned)sim->prefetch_latency) {
+        sim->prefetch_stats.late++;
+      }
+      // los bloques anteriores al encontrado ya no sirven
+      for (int j = 0; j < i; j++) {
+        if (sb->dirty[j]) {
+          lower_writeback(sim, 0, sb->blocks[j] << ptr_cache->index_mask_offset);
+        }
+      }
+      sb->count -= i + 1;
+      memmove(sb->blocks, sb->blocks + i + 1, sizeof(sim_addr) * sb->count);
+      memmove(sb->dirty, sb->dirty + i + 1, sb->count);
+      memmove(sb->times, sb->times + i + 1, sizeof(unsigned) * sb->count);
+      sb->last_use = ++pf->stream_clock;
+      return dirty ? PREFETCH_BUFFERED_DIRTY : PREFETCH_BUFFERED;
+    }
+  }
+  return PREFETCH_NOT_BUFFERED;
+}
+
+// un hit de demanda en la línea way; si la trajo el prefetcher y
+// es su primer uso lo cuenta como útil (y tardío si llegó antes de
+// la latencia del prefetch). Regresa TRUE en ese caso
+int prefetch_hit(Pcache_sim sim, Pcache ptr_cache, int index, int way)
+{
+  Pcache_line line = &ptr_cache->lines[index * ptr_cache->associativity + way];
+
+  if (!line->prefetched) {
+    return FALSE;
+  }
+  line->prefetched = FALSE;
+  sim->prefetch_stats.useful++;
+  if (prefetch_now(sim) - line->prefetch_time < (unsigned)sim->prefetch_latency) {
+    sim->prefetch_stats.late++;
+  }
+  return TRUE;
+}
+/************************************************************/
+
+/************************************************************/
+// después de cada referencia de demanda al bloque (index, tag):
+// entrena al prefetcher y pide los bloques que correspondan.
+// prefetched es TRUE si la referencia la resolvió un prefetch
+// (primer hit a una línea traída o bloque tomado de un buffer)
+void prefetch_issue(Pcache_sim sim, Pcache ptr_cache, int index, sim_addr tag, int is_hit, int prefetched)
+{
+  Pprefetcher pf = ptr_cache->prefetcher;
+  sim_addr addr = block_address(ptr_cache, index, tag);
+  sim_addr block = addr >> ptr_cache->index_mask_offset;
+  int d;
+
+  switch (pf->kind) {
+  case PREFETCH_NEXTLINE:
+    if (!is_hit) {
+      for (d = 1; d <= pf->degree; d++) {
+        prefetch_block(sim, ptr_cache, block + d);
+      }
+    }
+    break;
+  case PREFETCH_TAGGED:
+    if (!is_hit || prefetched) {
+      for (d = 1; d <= pf->degree; d++) {
+        prefetch_block(sim, ptr_cache, block + d);
+      }
+    }
+    break;
+  case PREFETCH_STRIDE: {
+    sim_addr region = addr >> PREFETCH_REGION_BITS;
+    stride_entry *e = &pf->strides[(BLOCK_HASH(region) >> 16) % PREFETCH_STRIDE_ENTRIES];
+    int delta = (int)(block - e->last_block);
+    if (e->region != region) {
+      e->region = region;
+      e->last_block = block;
+      e->stride = 0;
+      e->confidence = 0;
+      break;
+    }
+    if (delta == 0) {
+      break;
+    }
+    if (delta == e->stride) {
+      e->confidence += e->confidence < 3;
+    } else {
+      e->stride = delta;
+      e->confidence = 0;
+    }
+    e->last_block = block;
+    if (e->confidence > 0) {
+      for (d = 1; d <= pf->degree; d++) {
+        prefetch_block(sim, ptr_cache, block + d * e->stride);
+      }
+    }
+    break;
+  }
+  case PREFETCH_STREAM: {
+    stream_buffer *sb;
+    sim_addr next;
+    if (is_hit) {
+      break;
+    }
+    if (prefetched) {
+      // el buffer que tenía el bloque (el más reciente) se rellena
+      sb = &pf->streams[0];
+      for (int b = 1; b < PREFETCH_STREAMS; b++) {
+        if (pf->streams[b].last_use > sb->last_use) {
+          sb = &pf->streams[b];
+        }
+      }
+      next = sb->count ? sb->blocks[sb->count - 1] + 1 : block + 1;
+    } else {
+      // fallo en cache y en buffers: un stream nuevo en el buffer
+      // menos recientemente usado
+      sb = &pf->streams[0];
+      for (int b = 1; b < PREFETCH_STREAMS; b++) {
+        if (pf->streams[b].last_use < sb->last_use) {
+          sb = &pf->streams[b];
+        }
+      }
+      stream_discard(sim, ptr_cache, sb);
+      sb->last_use = ++pf->stream_clock;
+      next = block + 1;
+    }
+    while (sb->count < PREFETCH_STREAM_DEPTH) {
+      stream_append(sim, ptr_cache, sb, next++);
+    }
+    break;
+  }
+  }
+}
+/************************************************************/
+
+/************************************************************/
+/* empties the stream buffers of an L1 cache at flush time */
+void prefetch_flush(Pcache_sim sim, Pcache ptr_cache)
+{
+  if (ptr_cache->prefetcher) {
+    for (int b = 0; b < PREFETCH_STREAMS; b++) {
+      stream_discard(sim, ptr_cache, &ptr_cache->prefetcher->streams[b]);
+    }
+  }
+}
+
+// imprime la configuración del prefetcher, como dump_settings()
+void dump_prefetch_settings(Pcache_sim sim)
+{
+  if (sim->prefetch_kind != PREFETCH_NONE) {
+    printf("  Prefetcher: \t\t%s (degree %d, latency %d)\n", prefetcher_name(sim->prefetch_kind),
+    sim->prefetch_degree, sim->prefetch_latency);
+  }
+}
+
+// imprime las estadísticas del prefetcher, como print_stats(). En
+// modo CSV agrega al renglón el prefetcher, su grado y los contadores
+void print_prefetch_stats(Pcache_sim sim)
+{
+  Pprefetch_stat stat = &sim->prefetch_stats;
+
+  if (sim->prefetch_kind == PREFETCH_NONE) {
+    return;
+  }
+  if (sim->debug) {
+    printf(" PREFETCH (%s)\n", prefetcher_name(sim->prefetch_kind));
+    printf("  issued:    %lld\n", stat->issued);
+    printf("  useful:    %lld\n", stat->useful);
+    printf("  late:      %lld\n", stat->late);
+    printf("  polluting: %lld\n", stat->polluting);
+    printf("  prefetch fetch:  %lld (%lld bytes)\n", stat->fetches, stat->fetch_bytes);
+    printf("\n");
+  } else {
+    printf(",%s,%d", prefetcher_name(sim->prefetch_kind), sim->prefetch_degree);
+    printf(",%lld,%lld,%lld,%lld,%lld", stat->issued, stat->useful, stat->late, stat->polluting, stat->fetches);
+  }
+}
+/************************************************************/
@@ -0,0 +1,16 @@
+/*
+ * prefetch.h
+ */
+
+/* resultado de prefetch_miss(): dónde estaba el bloque del fallo */
+#define PREFETCH_NOT_BUFFERED 0   /* has to be fetched from below */
+#define PREFETCH_BUFFERED 1       /* taken from a stream buffer */
+#define PREFETCH_BUFFERED_DIRTY 2 /* taken from a stream buffer, dirty */
+
+void init_prefetcher();
+int prefetch_miss();
+int prefetch_hit();
+void prefetch_issue();
+void prefetch_flush();
+void dump_prefetch_settings();
+void print_prefetch_stats();
@@ -0,0 +1,165 @@
+/*
+ * profile.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+#include "trace.h"
+
+#if defined(SIM_PROFILE)
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/************************************************************/
+// perfil del simulador (-DSIM_PROFILE): cada simulador mide con
+// el TSC cuánto tarda apply_access() y, dentro de ella, la
+// búsqueda de la línea y el reemplazo; el lector de la traza mide
+// read_trace_block(). Durante toda la simulación se cuentan además
+// ciclos, instrucciones, fallos del último nivel de cache y saltos
+// mal predichos del proceso con perf_event_open() (solo Linux, y
+// solo si el kernel lo permite: perf_event_paranoid).
+/************************************************************/
+
+static const char *phase_names[PROFILE_PHASES] = {
+  "access", "set lookup", "replacement"
+};
+
+static const char *event_names[PROFILE_EVENTS] = {
+  "cycles", "instructions", "LLC misses", "branch misses"
+};
+
+static int event_fd[PROFILE_EVENTS] = { -1, -1, -1, -1 };
+static long long event_count[PROFILE_EVENTS];
+static int events_read = FALSE;
+
+/************************************************************/
+/* helper function to add the profile of a shard to its simulator */
+void profile_merge(Psim_profile to, Psim_profile from)
+{
+  int p;
+
+  for (p = 0; p < PROFILE_PHASES; p++) {
+    to->ticks[p] += from->ticks[p];
+    to->calls[p] += from->calls[p];
+  }
+}
+
+// desglose por fase de un simulador, después de sus estadísticas.
+// En modo CSV va a stderr para no romper los renglones
+void print_profile(Pcache_sim sim)
+{
+  FILE *out = sim->debug ? stdout : stderr;
+  Psim_profile prof = &sim->profile;
+  unsigned long long rest;
+  int p;
+
+  if (!prof->calls[PROFILE_ACCESS])
+    return;
+  fprintf(out, " PROFILE (%s)\n", PROFILE_UNIT);
+  for (p = 0; p < PROFILE_PHASES; p++)
+    fprintf(out, "  %-12s %14llu in %12lld calls, %8.2f per reference\n", phase_names[p],
+            prof->ticks[p], prof->calls[p],
+            (double)prof->ticks[p] / prof->calls[PROFILE_ACCESS]);
+  // el resto de apply_access(): estadísticas, prefetcher, victim
+  // cache y niveles de abajo
+  rest = prof->ticks[PROFILE_ACCESS] - prof->ticks[PROFILE_LOOKUP] - prof->ticks[PROFILE_REPLACE];
+  fprintf(out, "  %-12s %14llu %23s %8.2f per reference\n", "other", rest, "",
+          (double)rest / prof->calls[PROFILE_ACCESS]);
+  fprintf(out, "\n");
+}
+/************************************************************/
+
+/************************************************************/
+#if defined(__linux__)
+/* helper function to open one hardware counter of this process and
+ * of the threads it creates later */
+static int open_event(unsigned long long config)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+// empieza a contar justo antes de simular; los hilos de -j,
+// --shards y --pipeline se crean después, así que también cuentan
+void profile_start_counters()
+{
+#if defined(__linux__)
+  static const unsigned long long configs[PROFILE_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+  int e;
+
+  for (e = 0; e < PROFILE_EVENTS; e++) {
+    event_fd[e] = open_event(configs[e]);
+    if (event_fd[e] >= 0) {
+      ioctl(event_fd[e], PERF_EVENT_IOC_RESET, 0);
+      ioctl(event_fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+// se llama cuando ya terminaron los hilos de la simulación: sus
+// cuentas ya están sumadas a las del proceso
+void profile_stop_counters()
+{
+#if defined(__linux__)
+  int e;
+
+  for (e = 0; e < PROFILE_EVENTS; e++) {
+    event_count[e] = -1;
+    if (event_fd[e] < 0)
+      continue;
+    ioctl(event_fd[e], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(event_fd[e], &event_count[e], sizeof(long long)) != sizeof(long long))
+      event_count[e] = -1;
+    close(event_fd[e]);
+    event_fd[e] = -1;
+  }
+  events_read = TRUE;
+#endif
+}
+
+// lectura de la traza y contadores de todo el proceso, al final
+// de todos los renglones (en stderr en modo CSV)
+void print_run_profile(Ptrace_reader reader, int debug)
+{
+  FILE *out = debug ? stdout : stderr;
+  long long refs = reader->read_records;
+  int e;
+
+  fprintf(out, "*** SIMULATOR PROFILE ***\n");
+  fprintf(out, "  trace read:  %llu %s for %lld references, %.2f per reference\n",
+          reader->read_ticks, PROFILE_UNIT, refs, refs ? (double)reader->read_ticks / refs : 0.0);
+  if (!events_read)
+    return;
+  for (e = 0; e < PROFILE_EVENTS; e++) {
+    if (event_count[e] < 0)
+      fprintf(out, "  %-14s not available\n", event_names[e]);
+    else
+      fprintf(out, "  %-14s %14lld, %8.2f per reference\n", event_names[e], event_count[e],
+              refs ? (double)event_count[e] / refs : 0.0);
+  }
+}
+/************************************************************/
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * profile.h
+ */
+
+/* perfil del simulador mismo, solo si se compila con -DSIM_PROFILE.
+ * Sin esa bandera las macros no generan código y los campos de
+ * perfil no existen, así que un binario normal no paga nada.
+ * Los tiempos son ticks del TSC (rdtsc) en x86 y nanosegundos de
+ * CLOCK_MONOTONIC en otras arquitecturas. */
+#if defined(SIM_PROFILE)
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define profile_now() __rdtsc()
+#define PROFILE_UNIT "TSC ticks"
+#else
+#include <time.h>
+static inline unsigned long long profile_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#define PROFILE_UNIT "ns"
+#endif
+
+/* fases de apply_access() que se miden por simulador; lo que queda
+ * de PROFILE_ACCESS sin las otras dos son las estadísticas, el
+ * prefetcher, el victim cache y los niveles de abajo */
+#define PROFILE_ACCESS 0  /* whole apply_access() */
+#define PROFILE_LOOKUP 1  /* get_line_way() of the L1 reference */
+#define PROFILE_REPLACE 2 /* full_insert() of an L1 miss: victim and fill */
+#define PROFILE_PHASES 3
+
+/* eventos de perf_event_open() que se cuentan durante la simulación */
+#define PROFILE_EVENTS 4
+
+/* structure definitions */
+typedef struct sim_profile_
+{
+  unsigned long long ticks[PROFILE_PHASES]; /* time spent in each phase */
+  long long calls[PROFILE_PHASES];          /* times each phase ran */
+} sim_profile, *Psim_profile;
+
+#define PROFILE_START(t) unsigned long long t = profile_now()
+#define PROFILE_STOP(prof, phase, t) \
+  ((prof)->ticks[phase] += profile_now() - (t), (prof)->calls[phase]++)
+
+void profile_merge();
+void print_profile();
+void profile_start_counters();
+void profile_stop_counters();
+void print_run_profile();
+
+#else
+
+#define PROFILE_START(t)
+#define PROFILE_STOP(prof, phase, t)
+
+#endif
@@ -0,0 +1,315 @@
+/*
+ * ring.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+
+#include "cache.h"
+#include "trace.h"
+#include "ring.h"
+
+/************************************************************/
+// lectura de una traza en hilos aparte. Cuando la traza llega
+// por un pipe (stdin o la salida de un descompresor) un hilo
+// lector hace el read() y la decodificación; con --pipeline una
+// traza mapeada se parte en pedazos que decodifican varios hilos.
+// Cada hilo deja bloques de referencias en su anillo y el
+// simulador solo los copia, en el orden de la traza. Si una etapa
+// va más rápido que la otra, espera cediendo el procesador; esas
+// esperas se miden para saber cuál etapa es el cuello de botella.
+/************************************************************/
+
+/* helper function to read a monotonic clock in nanoseconds */
+static unsigned long long pipeline_now()
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (unsigned long long)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/************************************************************/
+// primer byte de un registro en o después de offset: en texto el
+// que sigue a un fin de línea, en binario el que sigue a un byte
+// LEB128 sin bit de continuación
+static size_t chunk_boundary(Ptrace_pipeline pipeline, size_t offset)
+{
+  Ptrace_reader reader = pipeline->reader;
+  const unsigned char *data = (const unsigned char *)reader->data;
+
+  if (offset <= pipeline->begin)
+    return pipeline->begin;
+  if (offset >= reader->size)
+    return reader->size;
+  if (reader->binary) {
+    while (offset < reader->size && (data[offset - 1] & 0x80))
+      offset++;
+  } else {
+    while (offset < reader->size && data[offset - 1] != '\n')
+      offset++;
+  }
+  return offset;
+}
+
+// espera a que el simulador libere un bloque del anillo y lo
+// regresa, o NULL si se pidió detener la lectura
+static Ptrace_ring_slot ring_reserve(Ptrace_ring ring, unsigned long head)
+{
+  unsigned long long start = 0;
+
+  while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= TRACE_RING_SLOTS) {
+    if (atomic_load_explicit(&ring->pipeline->stop, memory_order_relaxed))
+      return NULL;
+    if (!start)
+      start = pipeline_now();
+    sched_yield();
+  }
+  if (start)
+    ring->stall_ns += pipeline_now() - start;
+  return &ring->slots[head % TRACE_RING_SLOTS];
+}
+
+// decodifica de reader hasta llenar bloques o llegar al final de
+// lo que reader puede leer. Con last marca el último bloque (que
+// puede quedar vacío). Regresa el nuevo head, 0 si se detuvo
+static unsigned long ring_fill(Ptrace_ring ring, Ptrace_reader reader, unsigned long head, int last)
+{
+  Ptrace_ring_slot slot;
+  unsigned long long start;
+  int n;
+
+  for (;;) {
+    slot = ring_reserve(ring, head);
+    if (slot == NULL)
+      return 0;
+    start = pipeline_now();
+    for (n = 0; n < TRACE_RING_BLOCK; n++)
+      if (!read_trace_record(reader, &slot->types[n], &slot->addrs[n]))
+        break;
+    slot->count = n;
+    slot->last = last && n < TRACE_RING_BLOCK;
+    if (slot->last)
+      memcpy(slot->delta, reader->prev_addr, sizeof(slot->delta));
+    ring->refs += n;
+    ring->busy_ns += pipeline_now() - start;
+    if (n > 0 || slot->last)
+      atomic_store_explicit(&ring->head, ++head, memory_order_release);
+    if (n < TRACE_RING_BLOCK)
+      return head;
+  }
+}
+
+// cuerpo de cada hilo lector
+static void *ring_reader_main(void *arg)
+{
+  Ptrace_ring ring = (Ptrace_ring)arg;
+  Ptrace_pipeline pipeline = ring->pipeline;
+  Ptrace_reader reader = pipeline->reader;
+  trace_reader view;
+  unsigned long head = 0;
+  size_t k;
+
+  if (!pipeline->chunked) {
+    ring_fill(ring, reader, head, FALSE);
+    atomic_store_explicit(&ring->done, TRUE, memory_order_release);
+    return NULL;
+  }
+
+  // cada pedazo se lee con una vista propia de la traza mapeada;
+  // en binario las direcciones salen relativas al inicio del pedazo
+  for (k = ring->index; k < pipeline->n_chunks; k += pipeline->n_rings) {
+    memset(&view, 0, sizeof(view));
+    view.data = reader->data;
+    view.pos = chunk_boundary(pipeline, pipeline->begin + k * TRACE_PIPE_CHUNK);
+    view.size = chunk_boundary(pipeline, pipeline->begin + (k + 1) * TRACE_PIPE_CHUNK);
+    view.mapped = TRUE;
+    view.eof = TRUE;
+    view.binary = reader->binary;
+    view.remaining = ~0ull;
+    ring->bytes += view.size - view.pos;
+    head = ring_fill(ring, &view, head, TRUE);
+    if (head == 0)
+      break;
+  }
+  atomic_store_explicit(&ring->done, TRUE, memory_order_release);
+  return NULL;
+}
+/************************************************************/
+
+/************************************************************/
+// arranca n_parsers hilos lectores de una traza ya abierta. Solo
+// una traza mapeada se puede partir en pedazos; cualquier otra se
+// lee con un solo hilo. Regresa NULL si no se pudo crear un hilo
+// (la traza se lee entonces sin ellos)
+Ptrace_pipeline start_trace_pipeline(reader, n_parsers)
+  struct trace_reader_ *reader;
+  int n_parsers;
+{
+  Ptrace_pipeline pipeline = (Ptrace_pipeline)calloc(1, sizeof(trace_pipeline));
+  int i;
+
+  if (!reader->mapped || n_parsers < 1)
+    n_parsers = 1;
+  if (n_parsers > TRACE_MAX_PARSERS)
+    n_parsers = TRACE_MAX_PARSERS;
+
+  pipeline->reader = reader;
+  pipeline->n_rings = n_parsers;
+  pipeline->chunked = reader->mapped;
+  pipeline->begin = reader->pos;
+  // en binario los pedazos se suman a la última dirección leída,
+  // que no es 0 si la traza empezó en un checkpoint
+  memcpy(pipeline->base, reader->prev_addr, sizeof(pipeline->base));
+  pipeline->n_chunks = (reader->size - reader->pos + TRACE_PIPE_CHUNK - 1) / TRACE_PIPE_CHUNK;
+  pipeline->rings = (Ptrace_ring)calloc(n_parsers, sizeof(trace_ring));
+  atomic_init(&pipeline->stop, FALSE);
+  pipeline->start_ns = pipeline_now();
+
+  for (i = 0; i < n_parsers; i++) {
+    Ptrace_ring ring = &pipeline->rings[i];
+    ring->pipeline = pipeline;
+    ring->index = i;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->done, FALSE);
+    if (pthread_create(&ring->thread, NULL, ring_reader_main, ring)) {
+      pipeline->n_rings = i;
+      stop_trace_pipeline(pipeline);
+      return NULL;
+    }
+  }
+  return pipeline;
+}
+/************************************************************/
+
+/************************************************************/
+// libera el bloque actual y espera el siguiente bloque de la
+// traza, que está en el anillo del pedazo que sigue. Con pedazos
+// binarios corrige las direcciones con la dirección previa de
+// cada tipo al inicio del pedazo. Regresa FALSE al final
+static int pipeline_next_slot(Ptrace_pipeline pipeline)
+{
+  Ptrace_ring ring = &pipeline->rings[pipeline->ring];
+  Ptrace_ring_slot slot = pipeline->current;
+  unsigned long tail;
+  unsigned long long start = 0;
+  int i;
+
+  for (;;) {
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (slot != NULL) {
+      if (slot->last) {
+        if (pipeline->reader->binary)
+          for (i = 0; i < 4; i++)
+            pipeline->base[i] += slot->delta[i];
+        pipeline->ring = (pipeline->ring + 1) % pipeline->n_rings;
+      }
+      atomic_store_explicit(&ring->tail, ++tail, memory_order_release);
+      pipeline->current = slot = NULL;
+      ring = &pipeline->rings[pipeline->ring];
+      tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    }
+
+    while (atomic_load_explicit(&ring->head, memory_order_acquire) == tail) {
+      // done se publica después del último head, así que hay que
+      // volver a ver head antes de terminar
+      if (atomic_load_explicit(&ring->done, memory_order_acquire) &&
+          atomic_load_explicit(&ring->head, memory_order_acquire) == tail) {
+        if (start)
+          pipeline->wait_ns += pipeline_now() - start;
+        // los pedazos se decodifican con vistas que no llevan la
+        // cuenta de los registros del encabezado
+        if (pipeline->chunked && pipeline->reader->binary)
+          end_binary_trace(pipeline->reader, pipeline->refs);
+        return FALSE;
+      }
+      if (!start)
+        start = pipeline_now();
+      sched_yield();
+    }
+
+    slot = &ring->slots[tail % TRACE_RING_SLOTS];
+    if (slot->count > 0)
+      break;
+    // pedazo vacío: se pasa al siguiente
+    pipeline->current = slot;
+  }
+  if (start)
+    pipeline->wait_ns += pipeline_now() - start;
+
+  // en la versión 1 las direcciones dan la vuelta en 2^32
+  if (pipeline->chunked && pipeline->reader->binary)
+    for (i = 0; i < slot->count; i++)
+      slot->addrs[i] += pipeline->base[slot->types[i]];
+  if (pipeline->chunked && pipeline->reader->binary == 1)
+    for (i = 0; i < slot->count; i++)
+      slot->addrs[i] &= 0xffffffffull;
+  pipeline->current = slot;
+  pipeline->pos = 0;
+  pipeline->refs += slot->count;
+  return TRUE;
+}
+
+// igual que read_trace_element(), pero toma la referencia de los
+// hilos lectores
+int pipeline_read_element(pipeline, access_type, addr)
+  Ptrace_pipeline pipeline;
+  unsigned *access_type;
+  sim_addr *addr;
+{
+  Ptrace_ring_slot slot = pipeline->current;
+
+  if (slot == NULL || pipeline->pos == slot->count) {
+    if (!pipeline_next_slot(pipeline))
+      return (0);
+    slot = pipeline->current;
+  }
+  *access_type = slot->types[pipeline->pos];
+  *addr = slot->addrs[pipeline->pos];
+  pipeline->pos++;
+  return (1);
+}
+/************************************************************/
+
+/************************************************************/
+// imprime en stderr, para no mezclarlos con los renglones CSV,
+// los contadores de cada etapa: lo que decodificó cada hilo
+// lector, su tiempo ocupado y el que esperó a que el simulador
+// liberara bloques, y el tiempo que el simulador esperó a los
+// lectores. La etapa que más espera no es el cuello de botella
+void print_pipeline_stats(pipeline)
+  Ptrace_pipeline pipeline;
+{
+  double elapsed = (pipeline_now() - pipeline->start_ns) / 1e9;
+  int i;
+
+  for (i = 0; i < pipeline->n_rings; i++) {
+    Ptrace_ring ring = &pipeline->rings[i];
+    double busy = ring->busy_ns / 1e9;
+    fprintf(stderr, "parser %d: %llu refs, %llu bytes, busy %.3f s (%.1f Mrefs/s), stalled %.3f s\n",
+            i, ring->refs, ring->bytes, busy, busy > 0 ? ring->refs / busy / 1e6 : 0.0,
+            ring->stall_ns / 1e9);
+  }
+  fprintf(stderr, "simulator: %llu refs in %.3f s (%.1f Mrefs/s), waited %.3f s for parsers\n",
+          pipeline->refs, elapsed, elapsed > 0 ? pipeline->refs / elapsed / 1e6 : 0.0,
+          pipeline->wait_ns / 1e9);
+}
+
+// detiene los hilos lectores (si aún no terminaron) y libera los
+// anillos
+void stop_trace_pipeline(pipeline)
+  Ptrace_pipeline pipeline;
+{
+  int i;
+
+  atomic_store_explicit(&pipeline->stop, TRUE, memory_order_relaxed);
+  for (i = 0; i < pipeline->n_rings; i++)
+    pthread_join(pipeline->rings[i].thread, NULL);
+  free(pipeline->rings);
+  free(pipeline);
+}
+/************************************************************/
@@ -0,0 +1,84 @@
+/*
+ * ring.h
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* bloques del anillo entre cada hilo lector y el simulador; la
+ * memoria de los anillos es fija sin importar el tamaño de la traza */
+#define TRACE_RING_SLOTS 8
+/* referencias por bloque del anillo */
+#define TRACE_RING_BLOCK 4096
+/* separación de los contadores para que no compartan línea */
+#define TRACE_RING_LINE 64
+/* bytes de traza mapeada que decodifica un hilo lector a la vez */
+#define TRACE_PIPE_CHUNK (1 << 16)
+/* hilos lectores como máximo */
+#define TRACE_MAX_PARSERS 16
+
+/* structure definitions */
+// bloque de referencias decodificadas; type puede ser un tipo
+// no válido, que read_trace_block() descarta al consumirlo. last
+// marca el último bloque de un pedazo de la traza y, en una traza
+// binaria partida en pedazos, delta es lo que avanzó la dirección
+// previa de cada tipo dentro del pedazo
+typedef struct trace_ring_slot_
+{
+  int count;                          /* references in the slot */
+  int last;                           /* TRUE if it ends its chunk */
+  sim_addr delta[4];                  /* binary chunks: prev_addr advance */
+  unsigned types[TRACE_RING_BLOCK];
+  sim_addr addrs[TRACE_RING_BLOCK];
+} trace_ring_slot, *Ptrace_ring_slot;
+
+// anillo de un productor y un consumidor sin candados: el hilo
+// lector solo escribe head y el simulador solo escribe tail, así
+// que basta con publicarlos con release y leerlos con acquire.
+// El bloque head % TRACE_RING_SLOTS es el siguiente que llena el
+// lector y el tail % TRACE_RING_SLOTS el que lee el simulador;
+// los bloques se reciclan, no se pide memoria por bloque.
+// Los contadores de la etapa los escribe solo el hilo lector
+typedef struct trace_ring_
+{
+  trace_ring_slot slots[TRACE_RING_SLOTS];
+  _Alignas(TRACE_RING_LINE) atomic_ulong head; /* slots published */
+  atomic_int done;                      /* TRUE after the last slot */
+  unsigned long long refs;              /* references parsed */
+  unsigned long long bytes;             /* bytes of trace parsed, if mapped */
+  unsigned long long busy_ns;           /* time spent parsing */
+  unsigned long long stall_ns;          /* time waiting for a free slot */
+  _Alignas(TRACE_RING_LINE) atomic_ulong tail; /* slots released */
+  struct trace_pipeline_ *pipeline;
+  int index;                            /* parser number */
+  pthread_t thread;
+} trace_ring, *Ptrace_ring;
+
+// lectura de una traza en hilos aparte. Con un solo lector el
+// hilo lee la traza de principio a fin (pipes); con una traza
+// mapeada cada uno de los n lectores decodifica los pedazos
+// index, index + n, ... de TRACE_PIPE_CHUNK bytes y el simulador
+// los toma en orden, pedazo k del anillo k % n
+typedef struct trace_pipeline_
+{
+  struct trace_reader_ *reader;
+  int n_rings;
+  Ptrace_ring rings;
+  int chunked;                 /* TRUE if the parsers split a mapped trace */
+  size_t begin;                /* first byte of the records */
+  size_t n_chunks;
+  atomic_int stop;             /* asks the parsers to quit */
+  // estado del simulador (consumidor)
+  int ring;                    /* ring of the next chunk */
+  Ptrace_ring_slot current;    /* slot being consumed, NULL if none */
+  int pos;                     /* next reference of current */
+  sim_addr base[4];            /* binary chunks: prev_addr at chunk start */
+  unsigned long long refs;     /* references consumed */
+  unsigned long long wait_ns;  /* time waiting for the parsers */
+  unsigned long long start_ns;
+} trace_pipeline, *Ptrace_pipeline;
+
+Ptrace_pipeline start_trace_pipeline();
+int pipeline_read_element();
+void print_pipeline_stats();
+void stop_trace_pipeline();
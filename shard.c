@@ -0,0 +1,214 @@
+/*
+ * shard.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "cache.h"
+#include "main.h"
+#include "trace.h"
+#include "shard.h"
+
+/************************************************************/
+// simulación de un cache grande repartida por sets. Con LRU (y
+// las demás políticas deterministas) lo que pasa en un set solo
+// depende de las referencias a ese set, así que cada hilo simula
+// los sets cuyos bits bajos de índice son su número de shard. El
+// hilo que decodifica la traza manda cada referencia a la cola de
+// su shard y al final se suman las estadísticas de los shards.
+// Como todos los niveles usan el mismo tamaño de bloque y los bits
+// del shard son bits de índice de todos ellos, los fallos y los
+// write backs de un set de L1 caen en sets de L2 y L3 del mismo
+// shard: la jerarquía también se reparte sin cambiar resultados.
+/************************************************************/
+
+/* structure definitions */
+// bloque de referencias de un solo shard, con las direcciones ya
+// sin los bits del shard (ver sim_shard_address())
+typedef struct shard_block_
+{
+  int count;
+  unsigned char types[SHARD_BLOCK];
+  sim_addr addrs[SHARD_BLOCK];
+} shard_block;
+
+// cola de bloques entre el hilo que decodifica y un shard. El
+// bloque head % SHARD_QUEUE es el que se está llenando y el
+// tail % SHARD_QUEUE el que se simula; solo se toma el candado
+// para publicar o liberar un bloque completo
+typedef struct shard_queue_
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;    /* signaled when head or tail move */
+  unsigned long head;     /* blocks published */
+  unsigned long tail;     /* blocks released */
+  int done;               /* TRUE after the last block */
+  shard_block blocks[SHARD_QUEUE];
+} shard_queue;
+
+// argumento de cada hilo: su cola y su shard de cada configuración
+typedef struct shard_worker_
+{
+  shard_queue queue;
+  Pcache_sim *shards;     /* n_sims simulators, one per configuration */
+  int n_sims;
+  pthread_t thread;
+} shard_worker;
+
+/************************************************************/
+// espera a que el shard libere el bloque head y lo regresa vacío
+static shard_block *queue_reserve(shard_queue *queue)
+{
+  shard_block *block;
+
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->head - queue->tail == SHARD_QUEUE)
+    pthread_cond_wait(&queue->cond, &queue->mutex);
+  pthread_mutex_unlock(&queue->mutex);
+  block = &queue->blocks[queue->head % SHARD_QUEUE];
+  block->count = 0;
+  return block;
+}
+
+static void queue_publish(shard_queue *queue)
+{
+  pthread_mutex_lock(&queue->mutex);
+  queue->head++;
+  pthread_cond_signal(&queue->cond);
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+static void queue_finish(shard_queue *queue)
+{
+  pthread_mutex_lock(&queue->mutex);
+  queue->done = TRUE;
+  pthread_cond_signal(&queue->cond);
+  pthread_mutex_unlock(&queue->mutex);
+}
+/************************************************************/
+
+/************************************************************/
+// cuerpo de cada hilo: simula los bloques de su cola, cada uno
+// configuración por configuración, y al final vacía sus caches
+static void *shard_worker_main(void *arg)
+{
+  shard_worker *worker = (shard_worker *)arg;
+  shard_queue *queue = &worker->queue;
+  shard_block *block;
+  int i;
+
+  for (;;) {
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->head == queue->tail && !queue->done)
+      pthread_cond_wait(&queue->cond, &queue->mutex);
+    if (queue->head == queue->tail) {
+      pthread_mutex_unlock(&queue->mutex);
+      break;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    block = &queue->blocks[queue->tail % SHARD_QUEUE];
+    for (i = 0; i < worker->n_sims; i++)
+      sim_access_batch(worker->shards[i], block->types, block->addrs, block->count);
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->tail++;
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+  }
+
+  for (i = 0; i < worker->n_sims; i++)
+    sim_flush(worker->shards[i]);
+  return NULL;
+}
+/************************************************************/
+
+/************************************************************/
+// versión de play_trace() que reparte los sets de cada
+// configuración entre n_shards hilos (potencia de dos). Los bits
+// del shard son los primeros arriba del offset del bloque más
+// grande del barrido; sale con error si alguna configuración no
+// se puede partir (ver check_shard_config()). Las estadísticas
+// quedan en sims, como si se hubiera simulado cada uno completo
+void play_trace_sharded(inFile, sims, n_sims, n_shards, debug)
+    Ptrace_reader inFile;
+Pcache_sim *sims;
+int n_sims, n_shards, debug;
+{
+  static unsigned char types[TRACE_BLOCK];
+  static sim_addr addrs[TRACE_BLOCK];
+  shard_worker *workers;
+  shard_block **fill;
+  int shard_shift = 0, shard_bits = log2_int(n_shards);
+  long long num_inst = 0;
+  int n, consumed, i, s;
+
+  for (i = 0; i < n_sims; i++)
+    if (log2_int(sims[i]->cache_block_size) > shard_shift)
+      shard_shift = log2_int(sims[i]->cache_block_size);
+
+  workers = (shard_worker *)calloc(n_shards, sizeof(shard_worker));
+  fill = (shard_block **)malloc(sizeof(shard_block *) * n_shards);
+  for (s = 0; s < n_shards; s++) {
+    workers[s].shards = (Pcache_sim *)malloc(sizeof(Pcache_sim) * n_sims);
+    workers[s].n_sims = n_sims;
+    for (i = 0; i < n_sims; i++) {
+      workers[s].shards[i] = sim_create_shard(sims[i], shard_shift, shard_bits);
+      if (workers[s].shards[i] == NULL)
+        exit(-1);
+    }
+  }
+  for (s = 0; s < n_shards; s++) {
+    pthread_mutex_init(&workers[s].queue.mutex, NULL);
+    pthread_cond_init(&workers[s].queue.cond, NULL);
+    pthread_create(&workers[s].thread, NULL, shard_worker_main, &workers[s]);
+    fill[s] = queue_reserve(&workers[s].queue);
+  }
+
+  // igual que en play_trace(), read_trace_block ya descarta las
+  // referencias con tipos desconocidos
+  for (;;) {
+    n = read_trace_block(inFile, types, addrs, TRACE_BLOCK, &consumed);
+    if (!consumed)
+      break;
+
+    for (i = 0; i < n; i++) {
+      shard_block *block;
+      s = (addrs[i] >> shard_shift) & (n_shards - 1);
+      block = fill[s];
+      block->types[block->count] = types[i];
+      block->addrs[block->count] = sim_shard_address(addrs[i], shard_shift, shard_bits);
+      if (++block->count == SHARD_BLOCK) {
+        queue_publish(&workers[s].queue);
+        fill[s] = queue_reserve(&workers[s].queue);
+      }
+    }
+
+    for (; consumed > 0; consumed--) {
+      num_inst++;
+      if (!(num_inst % PRINT_INTERVAL) && debug)
+        printf("processed %lld references\n", num_inst);
+    }
+  }
+
+  for (s = 0; s < n_shards; s++) {
+    if (fill[s]->count)
+      queue_publish(&workers[s].queue);
+    queue_finish(&workers[s].queue);
+  }
+  for (s = 0; s < n_shards; s++) {
+    pthread_join(workers[s].thread, NULL);
+    pthread_mutex_destroy(&workers[s].queue.mutex);
+    pthread_cond_destroy(&workers[s].queue.cond);
+    for (i = 0; i < n_sims; i++) {
+      sim_merge_stats(sims[i], workers[s].shards[i]);
+      sim_destroy(workers[s].shards[i]);
+    }
+    free(workers[s].shards);
+  }
+  free(workers);
+  free(fill);
+}
+/************************************************************/
@@ -0,0 +1,13 @@
+/*
+ * shard.h
+ */
+
+/* referencias por bloque de la cola de cada shard */
+#define SHARD_BLOCK 4096
+/* bloques en la cola de cada shard; la memoria de las colas es
+ * fija sin importar el tamaño de la traza */
+#define SHARD_QUEUE 8
+/* shards como máximo (potencia de dos) */
+#define MAX_SHARDS 64
+
+void play_trace_sharded();
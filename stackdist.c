@@ -0,0 +1,318 @@
+/*
+ * stackdist.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+#include "main.h"
+#include "trace.h"
+#include "stackdist.h"
+
+/************************************************************/
+// funciones del árbol de Fenwick de un set
+static void stack_tree_add(Pstack_set set, int time, int value)
+{
+  for (; time <= set->capacity; time += time & -time)
+    set->tree[time] += value;
+}
+
+static int stack_tree_prefix(Pstack_set set, int time)
+{
+  int sum = 0;
+
+  for (; time > 0; time -= time & -time)
+    sum += set->tree[time];
+  return sum;
+}
+/************************************************************/
+
+/************************************************************/
+/* helper function to find (or add) a block in the block map; a
+ * new block has time -1 until stack_access() gives it a slot */
+static Pstack_block stack_find_block(Pstack_cache sc, sim_addr block)
+{
+  int is_new;
+  Pstack_block entry = (Pstack_block)block_map_find(&sc->blocks, block, &is_new);
+
+  if (is_new) {
+    entry->time = -1;
+    entry->dirty_max = -1;
+  }
+  return entry;
+}
+/************************************************************/
+
+/************************************************************/
+// renumera las marcas vivas de un set a los instantes 1..live
+// conservando su orden, duplicando la capacidad si más de la
+// mitad de los instantes siguen ocupados, y reconstruye el árbol
+static void stack_compact(Pstack_cache sc, Pstack_set set)
+{
+  sim_addr *owner = set->owner;
+  int old_now = set->now, t, j, time = 0;
+
+  if (2 * set->live > set->capacity)
+    set->capacity *= 2;
+  set->owner = (sim_addr *)malloc(sizeof(sim_addr) * (set->capacity + 1));
+  free(set->tree);
+  set->tree = (int *)calloc(set->capacity + 1, sizeof(int));
+
+  for (t = 1; t <= old_now; t++) {
+    if (owner[t] == STACK_NO_BLOCK)
+      continue;
+    time++;
+    set->owner[time] = owner[t];
+    set->tree[time] = 1;
+    stack_find_block(sc, owner[t])->time = time;
+  }
+  for (t = time + 1; t <= set->capacity; t++)
+    set->owner[t] = STACK_NO_BLOCK;
+  free(owner);
+
+  // construcción del árbol en O(n)
+  for (t = 1; t <= set->capacity; t++) {
+    j = t + (t & -t);
+    if (j <= set->capacity)
+      set->tree[j] += set->tree[t];
+  }
+  set->now = time;
+}
+/************************************************************/
+
+/************************************************************/
+static void stack_cache_init(Pstack_cache sc, int n_sets)
+{
+  int i, t;
+
+  sc->n_sets = n_sets;
+  sc->sets = (Pstack_set)calloc(n_sets, sizeof(stack_set));
+  for (i = 0; i < n_sets; i++) {
+    sc->sets[i].capacity = STACK_INITIAL_TIMES;
+    sc->sets[i].tree = (int *)calloc(STACK_INITIAL_TIMES + 1, sizeof(int));
+    sc->sets[i].owner = (sim_addr *)malloc(sizeof(sim_addr) * (STACK_INITIAL_TIMES + 1));
+    for (t = 0; t <= STACK_INITIAL_TIMES; t++)
+      sc->sets[i].owner[t] = STACK_NO_BLOCK;
+  }
+  init_block_map(&sc->blocks, sizeof(stack_block), STACK_INITIAL_BLOCKS);
+}
+
+static void stack_cache_free(Pstack_cache sc)
+{
+  for (int i = 0; i < sc->n_sets; i++) {
+    free(sc->sets[i].tree);
+    free(sc->sets[i].owner);
+  }
+  free(sc->sets);
+  free_block_map(&sc->blocks);
+}
+/************************************************************/
+
+/************************************************************/
+// procesa una referencia: calcula su distancia de pila dentro de
+// su set (acotada a cap) y actualiza los histogramas. dirty es un
+// arreglo de diferencias: los write backs de un episodio sucio
+// cuentan para todas las asociatividades en [dirty_max, distancia)
+static void stack_access(Pstack_cache sc, Pstack_stream stream, long long *dirty,
+                         sim_addr block, int is_store, int cap)
+{
+  Pstack_set set = &sc->sets[block & (sc->n_sets - 1)];
+  Pstack_block entry = stack_find_block(sc, block);
+  int distance;
+
+  stream->accesses++;
+  if (entry->time < 0) {
+    // primera referencia al bloque: falla en todos los tamaños y
+    // solo reemplaza si el set ya tenía tantos bloques como vías
+    distance = cap;
+    stream->cold_fills[set->live < cap ? set->live : cap]++;
+  } else {
+    distance = set->live - stack_tree_prefix(set, entry->time) + 1;
+    if (distance > cap)
+      distance = cap;
+    stack_tree_add(set, entry->time, -1);
+    set->owner[entry->time] = STACK_NO_BLOCK;
+    set->live--;
+  }
+  stream->hits[distance]++;
+
+  if (entry->dirty_max >= 0 && entry->dirty_max < distance) {
+    dirty[entry->dirty_max]++;
+    dirty[distance]--;
+  }
+  if (is_store) {
+    stream->stores++;
+    entry->dirty_max = 0;
+  } else if (entry->dirty_max >= 0 && distance > entry->dirty_max) {
+    entry->dirty_max = distance;
+  }
+
+  if (set->now == set->capacity)
+    stack_compact(sc, set);
+  entry->time = ++set->now;
+  set->owner[entry->time] = block;
+  stack_tree_add(set, entry->time, 1);
+  set->live++;
+}
+/************************************************************/
+
+/************************************************************/
+// llena las estadísticas de un simulador a partir de los
+// histogramas, para la asociatividad que le corresponde
+static void stack_fill_stats(Pcache_stat stat, Pstack_stream stream, int assoc, int words_per_block)
+{
+  long long hits = 0, cold_fills = 0;
+  int d;
+
+  for (d = 1; d <= assoc; d++)
+    hits += stream->hits[d];
+  for (d = 0; d < assoc; d++)
+    cold_fills += stream->cold_fills[d];
+
+  stat->accesses = stream->accesses;
+  stat->misses = stream->accesses - hits;
+  stat->replacements = stat->misses - cold_fills;
+  stat->demand_fetches = stat->misses * words_per_block;
+  stat->demand_bytes = stat->demand_fetches * WORD_SIZE;
+}
+/************************************************************/
+
+/************************************************************/
+// modo de análisis por distancia de pila (Mattson): en una sola
+// pasada sobre la traza obtiene las estadísticas LRU de todas las
+// configuraciones del barrido que comparten tamaño de bloque y
+// número de sets, pues una referencia es hit en un cache de A vías
+// si y solo si su distancia de pila dentro de su set es <= A.
+// La asociatividad de cada configuración es tamaño / (bloque * sets).
+// Solo aplica con reemplazo LRU y con write allocate: con no
+// write allocate las escrituras que fallan no entran al cache y
+// se pierde la propiedad de inclusión. Las configuraciones divididas cuyo cache
+// de instrucciones y de datos tendrían asociatividades distintas
+// no se pueden expresar con un solo -a y se descartan, avisando
+// en stderr cuál se quitó para no ensuciar los renglones CSV.
+// Regresa el número de configuraciones que quedan en sims.
+int play_trace_stack(inFile, sims, n_sims, n_sets, debug)
+    Ptrace_reader inFile;
+Pcache_sim *sims;
+int n_sims, n_sets, debug;
+{
+  stack_cache caches[2];
+  stack_stream streams[2]; // 0 instrucciones, 1 datos
+  long long *dirty, copies;
+  unsigned access_type;
+  sim_addr addr;
+  int i, k, d, kept, cap, offset, split, block_size;
+  long long num_inst = 0;
+
+  if (n_sets < 1 || (n_sets & (n_sets - 1))) {
+    printf("error:  the number of sets must be a power of two\n");
+    exit(-1);
+  }
+
+  // validación y asociatividad de cada configuración
+  split = sims[0]->cache_split;
+  block_size = sims[0]->cache_block_size;
+  cap = 1;
+  kept = 0;
+  for (i = 0; i < n_sims; i++) {
+    Pcache_sim sim = sims[i];
+    int size = sim->cache_split ? sim->cache_isize : sim->cache_usize;
+    if (sim->cache_block_size != block_size || !sim->cache_writealloc) {
+      printf("error:  --stack needs a single block size and write allocate\n");
+      exit(-1);
+    }
+    if (sim->replacement != REPLACE_LRU) {
+      printf("error:  --stack only models LRU replacement\n");
+      exit(-1);
+    }
+    if (sim->lower_size[0] > 0) {
+      printf("error:  --stack only models a single cache level\n");
+      exit(-1);
+    }
+    if (sim->prefetch_kind != PREFETCH_NONE || sim->victim_entries > 0 || sim->classify ||
+        (sim->wbuf_entries > 0 && !sim->cache_writeback)) {
+      printf("error:  --stack does not model prefetchers, victim caches, write buffers or miss classes\n");
+      exit(-1);
+    }
+    if (sim->cache_split && sim->cache_isize != sim->cache_dsize) {
+      fprintf(stderr, "notice:  --stack skips -is %d -ds %d, the two caches would need different associativities\n",
+              sim->cache_isize, sim->cache_dsize);
+      sim_destroy(sim);
+      continue;
+    }
+    if (size % (block_size * n_sets) || size < block_size * n_sets) {
+      printf("error:  size %d is not a multiple of %d sets of %d bytes\n", size, n_sets, block_size);
+      exit(-1);
+    }
+    set_cache_param(sim, CACHE_PARAM_ASSOC, size / (block_size * n_sets));
+    if (sim->cache_assoc + 1 > cap)
+      cap = sim->cache_assoc + 1;
+    sims[kept++] = sim;
+  }
+  if (kept == 0)
+    return 0;
+
+  offset = log2_int(block_size);
+  for (k = 0; k < 2; k++) {
+    stack_cache_init(&caches[k], n_sets);
+    memset(&streams[k], 0, sizeof(stack_stream));
+    streams[k].hits = (long long *)calloc(cap + 1, sizeof(long long));
+    streams[k].cold_fills = (long long *)calloc(cap + 1, sizeof(long long));
+  }
+  dirty = (long long *)calloc(cap + 2, sizeof(long long));
+
+  while (read_trace_element(inFile, &access_type, &addr)) {
+    switch (access_type) {
+    case TRACE_DATA_LOAD:
+    case TRACE_DATA_STORE:
+      stack_access(&caches[split], &streams[1], dirty, addr >> offset,
+                   access_type == TRACE_DATA_STORE, cap);
+      break;
+    case TRACE_INST_LOAD:
+      stack_access(&caches[0], &streams[0], dirty, addr >> offset, FALSE, cap);
+      break;
+    default:
+      print_skipped_access(access_type);
+    }
+
+    num_inst++;
+    if (!(num_inst % PRINT_INTERVAL) && debug)
+      printf("processed %lld references\n", num_inst);
+  }
+
+  // los bloques que siguen sucios al final se escriben en el flush
+  // de todos los caches de al menos dirty_max vías
+  for (k = 0; k < 2; k++)
+    for (unsigned j = 0; j < caches[k].blocks.map_size; j++) {
+      Pstack_block entry = (Pstack_block)caches[k].blocks.entries + j;
+      if (entry->time > 0 && entry->dirty_max >= 0)
+        dirty[entry->dirty_max]++;
+    }
+
+  for (i = 0; i < kept; i++) {
+    Pcache_sim sim = sims[i];
+    stack_fill_stats(&sim->cache_stat_inst, &streams[0], sim->cache_assoc, sim->words_per_block);
+    stack_fill_stats(&sim->cache_stat_data, &streams[1], sim->cache_assoc, sim->words_per_block);
+    if (sim->cache_writeback) {
+      copies = 0;
+      for (d = 0; d <= sim->cache_assoc; d++)
+        copies += dirty[d];
+      sim->cache_stat_data.copies_back = copies * sim->words_per_block;
+    } else {
+      // en write through cada escritura va a memoria
+      sim->cache_stat_data.copies_back = streams[1].stores;
+    }
+    sim->cache_stat_data.copies_back_bytes = sim->cache_stat_data.copies_back * WORD_SIZE;
+  }
+
+  for (k = 0; k < 2; k++) {
+    stack_cache_free(&caches[k]);
+    free(streams[k].hits);
+    free(streams[k].cold_fills);
+  }
+  free(dirty);
+  return kept;
+}
+/************************************************************/
@@ -0,0 +1,56 @@
+/*
+ * stackdist.h
+ */
+
+/* capacidad inicial del árbol de Fenwick de cada set y del
+ * mapa de bloques; ambos crecen al doble cuando se llenan */
+#define STACK_INITIAL_TIMES 16
+#define STACK_INITIAL_BLOCKS 1024
+
+/* marca de "ningún bloque" en el arreglo owner de un set; un
+ * número de bloque nunca usa los 64 bits */
+#define STACK_NO_BLOCK (~0ull)
+
+/* structure definitions */
+// pila LRU de un set representada con marcas de tiempo: cada
+// bloque del set tiene una marca en el instante de su última
+// referencia y un árbol de Fenwick cuenta cuántas marcas hay
+// después de un instante dado. Ese conteo más uno es la distancia
+// de pila (posición LRU) del bloque. Cuando se acaban los
+// instantes se renumeran las marcas vivas de forma compacta.
+typedef struct stack_set_
+{
+  int capacity;    /* number of time slots */
+  int now;         /* last time slot used */
+  int live;        /* number of blocks seen in the set */
+  int *tree;       /* Fenwick tree over time slots, 1-based */
+  sim_addr *owner; /* block marked at each time slot */
+} stack_set, *Pstack_set;
+
+// entrada del mapa de bloques (direccionamiento abierto)
+typedef struct stack_block_
+{
+  sim_addr key;    /* block number (address >> log2(block size)) + 1 */
+  int time;        /* time slot of the last reference, 0 if empty */
+  int dirty_max;   /* max distance since the last write, -1 if never written */
+} stack_block, *Pstack_block;
+
+// todas las pilas de un cache (o del cache unificado)
+typedef struct stack_cache_
+{
+  int n_sets;
+  Pstack_set sets;
+  block_map blocks;   /* of stack_block */
+} stack_cache, *Pstack_cache;
+
+// histogramas de un flujo de referencias (instrucciones o datos)
+// indexados por distancia de pila, acotada a max_assoc + 1
+typedef struct stack_stream_
+{
+  long long accesses;
+  long long stores;
+  long long *hits;        /* references at each distance */
+  long long *cold_fills;  /* first references by blocks already in the set */
+} stack_stream, *Pstack_stream;
+
+int play_trace_stack();
@@ -0,0 +1,198 @@
+/*
+ * sweep.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "cache.h"
+#include "main.h"
+#include "trace.h"
+#include "sweep.h"
+#include "interval.h"
+
+/* structure definitions */
+// barrera reutilizable: pthread_barrier_t no existe en macOS
+typedef struct sweep_barrier_
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int parties;    /* threads that must arrive */
+  int waiting;    /* threads already waiting */
+  int generation; /* changes every time the barrier opens */
+} sweep_barrier;
+
+// estado compartido entre el hilo que decodifica la traza y
+// los hilos que simulan
+typedef struct sweep_state_
+{
+  Pcache_sim *sims;
+  Pinterval_series *series; /* time series of each configuration, or NULL */
+  int n_sims;
+  int n_threads;
+  Ptrace_chunk current;   /* chunk the workers simulate next */
+  sweep_barrier start;    /* opens when current is ready */
+  sweep_barrier done;     /* opens when every worker finished current */
+} sweep_state;
+
+// argumento de cada hilo: simula las configuraciones
+// first, first + n_threads, first + 2 * n_threads, ...
+typedef struct sweep_worker_
+{
+  sweep_state *state;
+  int first;
+  pthread_t thread;
+} sweep_worker;
+
+/************************************************************/
+static void barrier_init(sweep_barrier *barrier, int parties)
+{
+  pthread_mutex_init(&barrier->mutex, NULL);
+  pthread_cond_init(&barrier->cond, NULL);
+  barrier->parties = parties;
+  barrier->waiting = 0;
+  barrier->generation = 0;
+}
+
+static void barrier_wait(sweep_barrier *barrier)
+{
+  int generation;
+
+  pthread_mutex_lock(&barrier->mutex);
+  generation = barrier->generation;
+  if (++barrier->waiting == barrier->parties) {
+    barrier->waiting = 0;
+    barrier->generation++;
+    pthread_cond_broadcast(&barrier->cond);
+  } else {
+    while (generation == barrier->generation)
+      pthread_cond_wait(&barrier->cond, &barrier->mutex);
+  }
+  pthread_mutex_unlock(&barrier->mutex);
+}
+
+static void barrier_destroy(sweep_barrier *barrier)
+{
+  pthread_mutex_destroy(&barrier->mutex);
+  pthread_cond_destroy(&barrier->cond);
+}
+/************************************************************/
+
+/************************************************************/
+// lee de la traza hasta SWEEP_CHUNK referencias válidas. Las
+// de tipo desconocido se reportan y se descartan aquí, igual
+// que en play_trace(). Regresa el número de referencias leídas.
+static int fill_chunk(Ptrace_reader reader, Ptrace_chunk chunk, long long *num_inst, int debug)
+{
+  int consumed;
+
+  chunk->count = read_trace_block(reader, chunk->types, chunk->addrs, SWEEP_CHUNK, &consumed);
+  for (; consumed > 0; consumed--) {
+    (*num_inst)++;
+    if (!(*num_inst % PRINT_INTERVAL) && debug)
+      printf("processed %lld references\n", *num_inst);
+  }
+  return chunk->count;
+}
+/************************************************************/
+
+/************************************************************/
+// cuerpo de cada hilo simulador: espera a que haya un bloque
+// listo, lo pasa completo por cada una de sus configuraciones
+// y avisa al terminar. Un bloque vacío indica fin de traza.
+static void *sweep_worker_main(void *arg)
+{
+  sweep_worker *worker = (sweep_worker *)arg;
+  sweep_state *state = worker->state;
+  Ptrace_chunk chunk;
+  int i;
+
+  for (;;) {
+    barrier_wait(&state->start);
+    chunk = state->current;
+    if (chunk->count == 0)
+      break;
+
+    // se recorre el bloque configuración por configuración para
+    // que el estado de cada cache simulado se quede en el cache real
+    for (i = worker->first; i < state->n_sims; i += state->n_threads)
+      if (state->series)
+        interval_access_batch(state->series[i], chunk->types, chunk->addrs, chunk->count);
+      else
+        sim_access_batch(state->sims[i], chunk->types, chunk->addrs, chunk->count);
+
+    barrier_wait(&state->done);
+  }
+  return NULL;
+}
+/************************************************************/
+
+/************************************************************/
+// versión paralela de play_trace(): la traza se decodifica una
+// sola vez, por bloques, en este hilo y n_threads hilos se reparten
+// las configuraciones del barrido. Mientras los hilos simulan un
+// bloque se decodifica el siguiente en un segundo buffer. series
+// tiene la serie de tiempo de cada configuración, o es NULL
+void play_trace_parallel(inFile, sims, series, n_sims, n_threads, debug)
+    Ptrace_reader inFile;
+Pcache_sim *sims;
+Pinterval_series *series;
+int n_sims, n_threads, debug;
+{
+  sweep_state state;
+  sweep_worker *workers;
+  trace_chunk chunks[2];
+  long long num_inst = 0;
+  int cur = 0, i;
+
+  if (n_threads > n_sims)
+    n_threads = n_sims;
+
+  for (i = 0; i < 2; i++) {
+    chunks[i].types = (unsigned char *)malloc(SWEEP_CHUNK);
+    chunks[i].addrs = (sim_addr *)malloc(sizeof(sim_addr) * SWEEP_CHUNK);
+  }
+
+  state.sims = sims;
+  state.series = series;
+  state.n_sims = n_sims;
+  state.n_threads = n_threads;
+  barrier_init(&state.start, n_threads + 1);
+  barrier_init(&state.done, n_threads + 1);
+
+  workers = (sweep_worker *)malloc(sizeof(sweep_worker) * n_threads);
+  for (i = 0; i < n_threads; i++) {
+    workers[i].state = &state;
+    workers[i].first = i;
+    pthread_create(&workers[i].thread, NULL, sweep_worker_main, &workers[i]);
+  }
+
+  fill_chunk(inFile, &chunks[cur], &num_inst, debug);
+  for (;;) {
+    state.current = &chunks[cur];
+    barrier_wait(&state.start);
+    if (chunks[cur].count == 0)
+      break;
+    fill_chunk(inFile, &chunks[1 - cur], &num_inst, debug);
+    barrier_wait(&state.done);
+    cur = 1 - cur;
+  }
+
+  for (i = 0; i < n_threads; i++)
+    pthread_join(workers[i].thread, NULL);
+  barrier_destroy(&state.start);
+  barrier_destroy(&state.done);
+  free(workers);
+  for (i = 0; i < 2; i++) {
+    free(chunks[i].types);
+    free(chunks[i].addrs);
+  }
+
+  for (i = 0; i < n_sims; i++) {
+    sim_flush(sims[i]);
+    if (series)
+      interval_finish(series[i]);
+  }
+}
+/************************************************************/
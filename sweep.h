@@ -0,0 +1,19 @@
+/*
+ * sweep.h
+ */
+
+/* número de referencias que se decodifican por bloque; cada
+ * bloque lo recorren todos los hilos antes de pasar al siguiente */
+#define SWEEP_CHUNK (1 << 16)
+
+/* structure definitions */
+// bloque de referencias ya decodificadas que comparten los hilos
+// en modo de solo lectura
+typedef struct trace_chunk_
+{
+  int count;                /* number of references in the chunk */
+  unsigned char *types;     /* access type of each reference */
+  sim_addr *addrs;          /* address of each reference */
+} trace_chunk, *Ptrace_chunk;
+
+void play_trace_parallel();
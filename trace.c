@@ -0,0 +1,862 @@
+/*
+ * trace.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+#include "cache.h"
+#include "trace.h"
+#include "ring.h"
+
+/* una línea que no quepa en este número de bytes se sigue
+ * leyendo, pero ya no se garantiza que esté completa en el
+ * buffer al momento de decodificarla */
+#define TRACE_MAX_LINE 4096
+
+/* bytes que el hilo alimentador copia por cada read() */
+#define TRACE_FEED_SIZE (1 << 16)
+
+/* valor de cada caracter como dígito hexadecimal, 0xff si no lo es */
+static unsigned char hex_digit[256];
+
+/* las direcciones se decodifican de 8 en 8 caracteres dentro de
+ * una palabra de 64 bits (SWAR); hace falta leer la palabra con
+ * el primer caracter en el byte bajo */
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define TRACE_SWAR_HEX 1
+#define HEX_HIGH_BITS 0x8080808080808080ull
+#endif
+
+/* structure definitions */
+// formato comprimido reconocido por sus primeros bytes; se
+// descomprime con "<tool> -dc" en un proceso aparte
+typedef struct trace_format_
+{
+  unsigned char magic[TRACE_MAGIC_SIZE];
+  int size;          /* bytes of magic that must match */
+  const char *tool;  /* decompressor in the PATH */
+} trace_format;
+
+static const trace_format trace_formats[] = {
+  { { 0x1f, 0x8b }, 2, "gzip" },
+  { { 0x28, 0xb5, 0x2f, 0xfd }, 4, "zstd" },
+  { { 0xfd, '7', 'z', 'X', 'Z', 0x00 }, 6, "xz" },
+  { { 'B', 'Z', 'h' }, 3, "bzip2" },
+};
+
+// hilo que pasa una traza comprimida que llega por un pipe al
+// descompresor; los primeros bytes ya se leyeron para reconocer
+// el formato y se le escriben antes que el resto
+typedef struct trace_feeder_
+{
+  int in;            /* compressed input */
+  int out;           /* stdin of the decompressor */
+  unsigned char head[TRACE_MAGIC_SIZE];
+  int pending;       /* bytes of head to write first */
+  pthread_t thread;
+} trace_feeder;
+
+/************************************************************/
+// llena la tabla de dígitos hexadecimales que usa el decodificador
+// de direcciones, así cada dígito cuesta un solo acceso a memoria
+// en lugar de una cadena de comparaciones
+static void init_hex_digits()
+{
+  int c;
+
+  memset(hex_digit, 0xff, sizeof(hex_digit));
+  for (c = '0'; c <= '9'; c++)
+    hex_digit[c] = c - '0';
+  for (c = 'a'; c <= 'f'; c++)
+    hex_digit[c] = c - 'a' + 10;
+  for (c = 'A'; c <= 'F'; c++)
+    hex_digit[c] = c - 'A' + 10;
+}
+/************************************************************/
+
+#if defined(TRACE_SWAR_HEX)
+/************************************************************/
+// marca con el bit alto de cada byte los caracteres de word que
+// son dígitos hexadecimales. Cada rango se revisa con sumas que
+// encienden el bit alto del byte sin acarrear al siguiente
+static inline unsigned long long hex_digit_mask(unsigned long long word)
+{
+  unsigned long long ascii = ~word & HEX_HIGH_BITS;
+  unsigned long long x = word & ~HEX_HIGH_BITS;
+  unsigned long long lower = x | 0x2020202020202020ull;
+  unsigned long long digit, alpha;
+
+  // '0' <= x <= '9'
+  digit = (x + 0x5050505050505050ull) & ~(x + 0x4646464646464646ull);
+  // 'a' <= lower <= 'f', las mayúsculas ya pasaron a minúsculas
+  alpha = (lower + 0x1f1f1f1f1f1f1f1full) & ~(lower + 0x1919191919191919ull);
+  return (digit | alpha) & ascii;
+}
+
+// valor de los primeros n (1 a 8) caracteres de word, que deben
+// ser dígitos hexadecimales: cada byte pasa a su valor y los
+// nibbles se juntan por pares, luego de 2 en 2 bytes y de 4 en 4
+static inline unsigned long long hex_word_value(unsigned long long word, int n)
+{
+  // el nibble bajo de una letra vale 9 menos que la letra
+  word = (word & 0x0f0f0f0f0f0f0f0full) + ((word >> 6) & 0x0101010101010101ull) * 9;
+  word = __builtin_bswap64(word) >> (8 * (8 - n));
+  word = (word | (word >> 4)) & 0x00ff00ff00ff00ffull;
+  word = (word | (word >> 8)) & 0x0000ffff0000ffffull;
+  return (word | (word >> 16)) & 0xffffffffull;
+}
+/************************************************************/
+#endif
+
+/************************************************************/
+// rellena el buffer de lectura cuando la traza no está mapeada
+// a memoria. Los bytes que aún no se han leído se recorren al
+// inicio del buffer y el resto se completa con read()
+static void fill_trace_buffer(Ptrace_reader reader)
+{
+  size_t pending = reader->size - reader->pos;
+  long n;
+
+  memmove(reader->buffer, reader->buffer + reader->pos, pending);
+  reader->pos = 0;
+  reader->size = pending;
+
+  while (!reader->eof && reader->size < TRACE_BUFFER_SIZE) {
+    n = read(reader->fd, reader->buffer + reader->size, TRACE_BUFFER_SIZE - reader->size);
+    if (n <= 0)
+      reader->eof = TRUE;
+    else
+      reader->size += n;
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// revisa si la traza empieza con el encabezado del formato
+// binario; de ser así lee su versión y el número de registros y
+// deja pos apuntando al primer registro. Una versión desconocida
+// no se decodifica: la traza queda vacía y close_trace() falla
+static void detect_binary_trace(Ptrace_reader reader)
+{
+  const unsigned char *header = (const unsigned char *)reader->data;
+  int i;
+
+  if (reader->size < TRACE_BINARY_HEADER_SIZE || memcmp(header, TRACE_BINARY_MAGIC, 4))
+    return;
+
+  reader->binary = header[4];
+  if (reader->binary != 1 && reader->binary != TRACE_BINARY_VERSION) {
+    printf("error:  unsupported binary trace version %d\n", header[4]);
+    reader->binary = TRACE_BINARY_VERSION;
+    reader->remaining = 0;
+    reader->pos = reader->size;
+    reader->failed = TRUE;
+    return;
+  }
+  reader->remaining = 0;
+  for (i = 15; i >= 8; i--)
+    reader->remaining = (reader->remaining << 8) | header[i];
+  reader->records = reader->remaining;
+  reader->pos = TRACE_BINARY_HEADER_SIZE;
+}
+/************************************************************/
+
+/************************************************************/
+// regresa el descompresor de una traza que empieza con los n
+// bytes de head, o NULL si no está comprimida
+static const char *trace_decompressor(const unsigned char *head, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(trace_formats) / sizeof(trace_formats[0]); i++)
+    if (n >= (size_t)trace_formats[i].size &&
+        !memcmp(head, trace_formats[i].magic, trace_formats[i].size))
+      return trace_formats[i].tool;
+  return NULL;
+}
+
+#ifndef _WIN32
+/* helper function to write a whole buffer to a pipe */
+static int write_all(int fd, const unsigned char *data, size_t n)
+{
+  long written;
+
+  while (n > 0) {
+    written = write(fd, data, n);
+    if (written <= 0)
+      return -1;
+    data += written;
+    n -= written;
+  }
+  return 0;
+}
+
+static void *trace_feeder_main(void *arg)
+{
+  trace_feeder *feeder = (trace_feeder *)arg;
+  unsigned char *buffer = (unsigned char *)malloc(TRACE_FEED_SIZE);
+  long n;
+
+  if (write_all(feeder->out, feeder->head, feeder->pending) == 0) {
+    while ((n = read(feeder->in, buffer, TRACE_FEED_SIZE)) > 0)
+      if (write_all(feeder->out, buffer, n))
+        break;
+  }
+  close(feeder->out);
+  free(buffer);
+  return NULL;
+}
+
+// arranca "tool -dc" con la traza comprimida como entrada y deja
+// en reader->fd su salida. Si la traza es un archivo el proceso la
+// lee directamente; si es un pipe, sus primeros pending bytes ya
+// están en head y un hilo le pasa el resto. Regresa -1 si falla
+static int start_decompressor(Ptrace_reader reader, const char *tool,
+                              const unsigned char *head, int pending, int feed)
+{
+  int out[2], in[2] = { -1, -1 }, status[2];
+  int pid, error;
+
+  // status se cierra solo si exec() funciona; si no, el hijo
+  // escribe ahí su errno
+  if (pipe(out))
+    return -1;
+  if ((feed && pipe(in)) || pipe(status)) {
+    close(out[0]);
+    close(out[1]);
+    return -1;
+  }
+  fcntl(status[1], F_SETFD, FD_CLOEXEC);
+
+  pid = fork();
+  if (pid == 0) {
+    dup2(feed ? in[0] : reader->fd, STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    close(out[0]);
+    close(out[1]);
+    if (feed) {
+      close(in[0]);
+      close(in[1]);
+    }
+    close(status[0]);
+    close(reader->fd);
+    execlp(tool, tool, "-dc", (char *)NULL);
+    error = errno;
+    write(status[1], &error, sizeof(error));
+    _exit(127);
+  }
+
+  close(out[1]);
+  close(status[1]);
+  if (feed)
+    close(in[0]);
+  if (pid < 0 || read(status[0], &error, sizeof(error)) > 0) {
+    if (pid > 0)
+      waitpid(pid, NULL, 0);
+    close(status[0]);
+    close(out[0]);
+    if (feed)
+      close(in[1]);
+    return -1;
+  }
+  close(status[0]);
+
+  // si el descompresor termina antes de tiempo, write() falla con
+  // EPIPE en lugar de matar al simulador
+  signal(SIGPIPE, SIG_IGN);
+  if (feed) {
+    reader->feeder = (trace_feeder *)calloc(1, sizeof(trace_feeder));
+    reader->feeder->in = reader->fd;
+    reader->feeder->out = in[1];
+    memcpy(reader->feeder->head, head, pending);
+    reader->feeder->pending = pending;
+    pthread_create(&reader->feeder->thread, NULL, trace_feeder_main, reader->feeder);
+  }
+  reader->source_fd = reader->fd;
+  reader->fd = out[0];
+  reader->child = pid;
+  reader->tool = tool;
+  return 0;
+}
+#endif
+/************************************************************/
+
+/************************************************************/
+// abre un archivo *.trace, o la entrada estándar si path es "-".
+// Se intenta mapear a memoria para que el decodificador lea
+// directamente de las páginas del archivo; si no se puede (pipes,
+// FIFOs o sistemas sin mmap) se recurre a un buffer alineado que
+// se va llenando por bloques grandes y la traza se decodifica en
+// un hilo aparte (ver ring.c). Las trazas comprimidas con gzip,
+// zstd, xz o bzip2 se reconocen por sus primeros bytes y se leen
+// de la salida del descompresor, que corre en otro proceso.
+// Regresa NULL si el archivo no se puede abrir.
+Ptrace_reader open_trace(path)
+  const char *path;
+{
+  Ptrace_reader reader;
+  struct stat info;
+  unsigned char head[TRACE_MAGIC_SIZE];
+  const char *tool = NULL;
+  int fd, regular;
+  long n;
+
+  fd = strcmp(path, "-") ? open(path, O_RDONLY) : dup(STDIN_FILENO);
+  if (fd < 0)
+    return NULL;
+
+  if (hex_digit['a'] != 10)
+    init_hex_digits();
+
+  reader = (Ptrace_reader)calloc(1, sizeof(trace_reader));
+  reader->fd = fd;
+  reader->source_fd = -1;
+
+  regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+#ifndef _WIN32
+  if (regular && info.st_size > 0) {
+    n = pread(fd, head, TRACE_MAGIC_SIZE, 0);
+    tool = trace_decompressor(head, n > 0 ? n : 0);
+  }
+  if (regular && info.st_size > 0 && tool == NULL) {
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      madvise(map, info.st_size, MADV_SEQUENTIAL);
+      reader->data = (const char *)map;
+      reader->size = info.st_size;
+      reader->mapped = TRUE;
+      reader->eof = TRUE;
+      detect_binary_trace(reader);
+      return reader;
+    }
+  }
+#endif
+
+#ifdef _WIN32
+  reader->buffer = (char *)_aligned_malloc(TRACE_BUFFER_SIZE, TRACE_BUFFER_ALIGN);
+#else
+  if (posix_memalign((void **)&reader->buffer, TRACE_BUFFER_ALIGN, TRACE_BUFFER_SIZE))
+    reader->buffer = NULL;
+#endif
+  if (reader->buffer == NULL) {
+    close(fd);
+    free(reader);
+    return NULL;
+  }
+  reader->data = reader->buffer;
+
+  // de un pipe no se puede volver a leer el inicio: los bytes que
+  // identifican el formato se quedan en el buffer o se le pasan al
+  // descompresor
+  if (!regular) {
+    while (reader->size < TRACE_MAGIC_SIZE) {
+      n = read(fd, reader->buffer + reader->size, TRACE_MAGIC_SIZE - reader->size);
+      if (n <= 0)
+        break;
+      reader->size += n;
+    }
+    tool = trace_decompressor((const unsigned char *)reader->buffer, reader->size);
+  }
+  if (tool != NULL) {
+#ifdef _WIN32
+    printf("error:  compressed traces are not supported on Windows\n");
+    close_trace(reader);
+    return NULL;
+#else
+    if (start_decompressor(reader, tool, (const unsigned char *)reader->buffer, reader->size, !regular)) {
+      printf("error:  can not start %s to decompress the trace\n", tool);
+      close_trace(reader);
+      return NULL;
+    }
+    reader->size = 0;
+#endif
+  }
+
+  fill_trace_buffer(reader);
+  detect_binary_trace(reader);
+  reader->pipeline = start_trace_pipeline(reader, 1);
+  return reader;
+}
+/************************************************************/
+
+/************************************************************/
+// lee una línea de una traza de texto
+// El formato de cada línea es "<tipo> <dirección hex>", por
+// ejemplo "2 408ed4"; todo lo que siga a la dirección en la
+// misma línea se ignora y las líneas en blanco se saltan, igual
+// que con fscanf("%u %x%c"). Una línea que no empieza con un
+// tipo decimal se reporta con tipo TRACE_MALFORMED y una sin
+// dirección válida con TRACE_BAD_ADDRESS, para que play_trace()
+// la descarte.
+// Regresa 0 cuando se alcanza el final del archivo.
+static int read_text_element(Ptrace_reader reader, unsigned *access_type, sim_addr *addr)
+{
+  const char *p, *end;
+  unsigned type, digit;
+  sim_addr value;
+  int n = 0;
+
+  for (;;) {
+    if (!reader->eof && reader->size - reader->pos < TRACE_MAX_LINE)
+      fill_trace_buffer(reader);
+
+    p = reader->data + reader->pos;
+    end = reader->data + reader->size;
+
+    // se saltan espacios y líneas en blanco antes del tipo
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r'))
+      p++;
+    reader->pos = p - reader->data;
+    if (p < end)
+      break;
+    if (reader->eof)
+      return (0);
+  }
+
+  // tipo de acceso en decimal
+  type = 0;
+  digit = (unsigned char)*p - '0';
+  if (digit > 9)
+    type = TRACE_MALFORMED;
+  while (digit <= 9) {
+    type = type * 10 + digit;
+    if (++p == end)
+      break;
+    digit = (unsigned char)*p - '0';
+  }
+
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+
+  // dirección en hexadecimal, con o sin prefijo 0x; una que no
+  // cabe en 64 bits está mal formada, no se trunca
+  if (end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' && hex_digit[(unsigned char)p[2]] < 16)
+    p += 2;
+  value = 0;
+#if defined(TRACE_SWAR_HEX)
+  // con 16 bytes por delante, las direcciones de hasta 15 dígitos
+  // se decodifican por palabras sin revisar cada caracter
+  if (end - p >= 16) {
+    unsigned long long word, next, invalid;
+    memcpy(&word, p, 8);
+    invalid = ~hex_digit_mask(word) & HEX_HIGH_BITS;
+    if (invalid) {
+      n = __builtin_ctzll(invalid) >> 3;
+      if (n)
+        value = hex_word_value(word, n);
+    } else {
+      memcpy(&next, p + 8, 8);
+      invalid = ~hex_digit_mask(next) & HEX_HIGH_BITS;
+      if (invalid) {
+        n = __builtin_ctzll(invalid) >> 3;
+        value = hex_word_value(word, 8);
+        if (n)
+          value = (value << (4 * n)) | hex_word_value(next, n);
+        n += 8;
+      }
+    }
+    p += n;
+  }
+#endif
+  // al final del buffer, o sin dígitos, o con 16 o más, se sigue
+  // un caracter a la vez
+  if (!n) {
+    if ((p == end || hex_digit[(unsigned char)*p] > 15) && type != TRACE_MALFORMED)
+      type = TRACE_BAD_ADDRESS;
+    while (p < end && (digit = hex_digit[(unsigned char)*p]) < 16) {
+      if ((value >> 60) && type != TRACE_MALFORMED)
+        type = TRACE_BAD_ADDRESS;
+      value = (value << 4) | digit;
+      p++;
+    }
+  }
+
+  *access_type = type;
+  *addr = value;
+
+  // casi siempre la línea termina justo después de la dirección
+  if (p < end && *p == '\n') {
+    reader->pos = p + 1 - reader->data;
+    return (1);
+  }
+  // se descarta el resto de la línea, incluso si no cabe en el buffer
+  for (;;) {
+    const char *newline = memchr(p, '\n', end - p);
+    if (newline != NULL) {
+      reader->pos = newline + 1 - reader->data;
+      break;
+    }
+    reader->pos = reader->size;
+    if (reader->eof)
+      break;
+    fill_trace_buffer(reader);
+    p = reader->data;
+    end = reader->data + reader->size;
+  }
+
+  return (1);
+}
+/************************************************************/
+
+/************************************************************/
+// decodifica un registro de una traza binaria (ver trace.h)
+// Regresa 0 cuando ya se leyeron todos los registros del
+// encabezado o el archivo está truncado.
+static int read_binary_element(Ptrace_reader reader, unsigned *access_type, sim_addr *addr)
+{
+  const unsigned char *p, *end;
+  unsigned long long value, high = 0, delta;
+  unsigned type;
+  int shift;
+
+  if (reader->remaining == 0)
+    return (0);
+  if (!reader->eof && reader->size - reader->pos < TRACE_MAX_LINE)
+    fill_trace_buffer(reader);
+
+  p = (const unsigned char *)reader->data + reader->pos;
+  end = (const unsigned char *)reader->data + reader->size;
+  if (p == end)
+    return end_binary_trace(reader, 0);
+
+  // la mayoría de los registros ocupan un solo byte
+  value = *p++;
+  if (value & 0x80) {
+    value &= 0x7f;
+    shift = 7;
+    do {
+      if (p == end || shift > 63)
+        return end_binary_trace(reader, 0);
+      value |= (unsigned long long)(*p & 0x7f) << shift;
+      // el décimo byte lleva los bits 63 a 65 del valor
+      if (shift == 63)
+        high = (*p & 0x7f) >> 1;
+      shift += 7;
+    } while (*p++ & 0x80);
+  }
+
+  type = value & 3;
+  delta = (value >> 2) | (high << 62);
+  // se deshace el zigzag y se suma a la dirección previa del tipo
+  if (reader->binary == 1) {
+    delta = (unsigned)delta;
+    reader->prev_addr[type] = (unsigned)(reader->prev_addr[type] + ((delta >> 1) ^ -(delta & 1)));
+  } else {
+    reader->prev_addr[type] += (delta >> 1) ^ -(delta & 1);
+  }
+
+  *access_type = type;
+  *addr = reader->prev_addr[type];
+  reader->pos = (const char *)p - reader->data;
+  reader->remaining--;
+  return (1);
+}
+/************************************************************/
+
+/************************************************************/
+// al final de una traza binaria revisa que se hayan leído todos
+// los registros que anuncia el encabezado; read son los que los
+// hilos lectores decodificaron sin descontarlos de remaining. Si
+// faltan registros la traza está truncada y se reporta una vez.
+// Regresa 0, el fin de la traza
+int end_binary_trace(reader, read)
+  Ptrace_reader reader;
+  unsigned long long read;
+{
+  if (reader->records && reader->remaining > read && !reader->failed) {
+    printf("error:  truncated binary trace (read %llu of %llu records)\n",
+           reader->records - reader->remaining + read, reader->records);
+    reader->failed = TRUE;
+  }
+  return (0);
+}
+/************************************************************/
+
+/************************************************************/
+// decodifica un registro de los archivos *.trace, ya sea en texto
+// o en el formato binario. Regresa 0 cuando se alcanza el final
+// del archivo. Solo lo llama el hilo que lee la traza
+int read_trace_record(reader, access_type, addr)
+  Ptrace_reader reader;
+  unsigned *access_type;
+  sim_addr *addr;
+{
+  if (reader->binary)
+    return read_binary_element(reader, access_type, addr);
+  return read_text_element(reader, access_type, addr);
+}
+
+// esta función lee un registro a la vez de los archivos *.trace,
+// del hilo lector si lo hay. Regresa 0 cuando se alcanza el final
+// del archivo.
+int read_trace_element(reader, access_type, addr)
+  Ptrace_reader reader;
+  unsigned *access_type;
+  sim_addr *addr;
+{
+  if (reader->pipeline)
+    return pipeline_read_element(reader->pipeline, access_type, addr);
+  return read_trace_record(reader, access_type, addr);
+}
+/************************************************************/
+
+/************************************************************/
+// reparte la decodificación de una traza mapeada entre n_parsers
+// hilos (ver ring.c). Una traza que llega por un pipe ya se
+// decodifica en su propio hilo desde open_trace()
+void pipeline_trace(reader, n_parsers)
+  Ptrace_reader reader;
+  int n_parsers;
+{
+  if (reader->pipeline == NULL)
+    reader->pipeline = start_trace_pipeline(reader, n_parsers);
+}
+
+// imprime los contadores de las etapas de lectura y simulación
+void print_trace_pipeline(reader)
+  Ptrace_reader reader;
+{
+  if (reader->pipeline)
+    print_pipeline_stats(reader->pipeline);
+}
+/************************************************************/
+
+/************************************************************/
+// posición de la traza para un checkpoint: regresa el byte que
+// sigue al último registro leído y copia en prev_addr la dirección
+// previa de cada tipo (formato binario). Regresa -1 si la traza no
+// está mapeada o la decodifican los hilos de --pipeline; entonces
+// solo se puede volver a ese punto leyendo los registros
+long long trace_offset(reader, prev_addr)
+  Ptrace_reader reader;
+  sim_addr *prev_addr;
+{
+  if (!reader->mapped || reader->pipeline)
+    return (-1);
+  memcpy(prev_addr, reader->prev_addr, sizeof(reader->prev_addr));
+  return (long long)reader->pos;
+}
+
+// continúa una traza recién abierta desde un checkpoint tomado
+// después de records registros: salta a offset si se conoce y la
+// traza está mapeada, si no lee y descarta los registros. Se llama
+// antes de pipeline_trace(). Regresa -1 si la traza es más corta
+int seek_trace(reader, offset, prev_addr, records)
+  Ptrace_reader reader;
+  long long offset;
+  const sim_addr *prev_addr;
+  long long records;
+{
+  unsigned access_type;
+  sim_addr addr;
+
+  if (offset >= 0 && reader->mapped && !reader->pipeline) {
+    if ((size_t)offset < reader->pos || (size_t)offset > reader->size ||
+        (reader->binary && reader->remaining < (unsigned long long)records))
+      return (-1);
+    reader->pos = (size_t)offset;
+    memcpy(reader->prev_addr, prev_addr, sizeof(reader->prev_addr));
+    if (reader->binary)
+      reader->remaining -= records;
+    return (0);
+  }
+  for (; records > 0; records--)
+    if (!read_trace_element(reader, &access_type, &addr))
+      return (-1);
+  return (0);
+}
+/************************************************************/
+
+/************************************************************/
+// reporta una referencia que se descarta, nombrando el problema
+void print_skipped_access(access_type)
+  unsigned access_type;
+{
+  if (access_type == TRACE_BAD_ADDRESS)
+    printf("skipping access, malformed address\n");
+  else if (access_type == TRACE_MALFORMED)
+    printf("skipping access, malformed type\n");
+  else
+    printf("skipping access, unknown type(%d)\n", access_type);
+}
+/************************************************************/
+
+/************************************************************/
+// lee hasta max referencias válidas de la traza en los arreglos
+// types y addrs, listos para sim_access_batch(). Las referencias
+// con tipo desconocido se reportan y se descartan, igual que en
+// play_trace(). En consumed se regresa el número de registros
+// leídos, incluyendo los descartados; si es 0 se llegó al final.
+// Regresa el número de referencias válidas.
+int read_trace_block(reader, types, addrs, max, consumed)
+  Ptrace_reader reader;
+  unsigned char *types;
+  sim_addr *addrs;
+  int max, *consumed;
+{
+  unsigned access_type;
+  sim_addr addr;
+  int n = 0;
+  PROFILE_START(start);
+
+  *consumed = 0;
+  while (n < max && read_trace_element(reader, &access_type, &addr)) {
+    (*consumed)++;
+    if (access_type > 2) {
+      print_skipped_access(access_type);
+      continue;
+    }
+    types[n] = access_type;
+    addrs[n] = addr;
+    n++;
+  }
+#if defined(SIM_PROFILE)
+  reader->read_ticks += profile_now() - start;
+  reader->read_records += n;
+#endif
+  return n;
+}
+/************************************************************/
+
+/************************************************************/
+// detiene el hilo lector, libera el mapeo o el buffer de lectura
+// y cierra el archivo. Si hubo descompresor se espera a que
+// termine y se reporta si falló. Regresa 0 si la traza se leyó
+// completa o -1 si el descompresor falló o la traza binaria
+// estaba truncada
+int close_trace(reader)
+  Ptrace_reader reader;
+{
+  int failed = 0;
+
+  if (reader->pipeline)
+    stop_trace_pipeline(reader->pipeline);
+#ifndef _WIN32
+  // si no se leyó todo, se consume el resto de la salida del
+  // descompresor: así termina por sí solo y su estado de salida
+  // dice si la traza estaba completa
+  if (reader->child > 0 && !reader->eof)
+    while (read(reader->fd, reader->buffer, TRACE_BUFFER_SIZE) > 0)
+      ;
+  if (reader->mapped)
+    munmap((void *)reader->data, reader->size);
+#endif
+#ifdef _WIN32
+  _aligned_free(reader->buffer);
+#else
+  free(reader->buffer);
+#endif
+  close(reader->fd);
+#ifndef _WIN32
+  if (reader->feeder) {
+    pthread_join(reader->feeder->thread, NULL);
+    free(reader->feeder);
+  }
+  if (reader->source_fd >= 0)
+    close(reader->source_fd);
+  if (reader->child > 0) {
+    int status;
+    if (waitpid(reader->child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+      printf("error:  %s -dc could not decompress the trace\n", reader->tool);
+      failed = -1;
+    }
+  }
+#endif
+  if (reader->failed)
+    failed = -1;
+  free(reader);
+  return failed;
+}
+/************************************************************/
+
+/************************************************************/
+// convierte una traza de texto al formato binario descrito en
+// trace.h. Los registros con un tipo desconocido o mal formados
+// no tienen representación binaria y se descartan. Regresa el
+// número de registros escritos o -1 si hubo un error de E/S.
+long long convert_trace(in_path, out_path)
+  const char *in_path, *out_path;
+{
+  Ptrace_reader reader;
+  FILE *out;
+  unsigned char header[TRACE_BINARY_HEADER_SIZE];
+  unsigned char record[10];
+  sim_addr prev_addr[3] = { 0, 0, 0 };
+  sim_addr addr, delta;
+  unsigned access_type;
+  unsigned long long count = 0, value, high;
+  int skipped = 0, n, i;
+
+  reader = open_trace(in_path);
+  if (reader == NULL) {
+    printf("error:  can not open trace file %s\n", in_path);
+    return (-1);
+  }
+  out = fopen(out_path, "wb");
+  if (out == NULL) {
+    printf("error:  can not create %s\n", out_path);
+    close_trace(reader);
+    return (-1);
+  }
+
+  // el número de registros se escribe al final, cuando ya se conoce
+  memset(header, 0, sizeof(header));
+  memcpy(header, TRACE_BINARY_MAGIC, 4);
+  header[4] = TRACE_BINARY_VERSION;
+  fwrite(header, 1, sizeof(header), out);
+
+  while (read_trace_element(reader, &access_type, &addr)) {
+    if (access_type > 2) {
+      skipped++;
+      continue;
+    }
+    delta = addr - prev_addr[access_type];
+    prev_addr[access_type] = addr;
+    // zigzag: el bit de signo pasa al bit menos significativo
+    delta = (delta << 1) ^ -(delta >> 63);
+    value = (delta << 2) | access_type;
+    high = delta >> 62;
+    n = 0;
+    while (value >= 0x80 || high) {
+      record[n++] = (value & 0x7f) | 0x80;
+      value = (value >> 7) | (high << 57);
+      high >>= 7;
+    }
+    record[n++] = (unsigned char)value;
+    fwrite(record, 1, n, out);
+    count++;
+  }
+  if (close_trace(reader)) {
+    fclose(out);
+    remove(out_path);
+    return (-1);
+  }
+
+  for (i = 0; i < 8; i++)
+    header[8 + i] = (count >> (8 * i)) & 0xff;
+  fseek(out, 8, SEEK_SET);
+  fwrite(header + 8, 1, 8, out);
+  if (fclose(out) != 0) {
+    printf("error:  can not write %s\n", out_path);
+    return (-1);
+  }
+
+  if (skipped)
+    printf("skipped %d records with unknown type\n", skipped);
+  return (long long)count;
+}
+/************************************************************/
@@ -0,0 +1,89 @@
+/*
+ * trace.h
+ */
+
+#include <stddef.h>
+
+/* tamaño del buffer con el que se lee una traza que no se puede
+ * mapear a memoria (pipes, FIFOs, Windows) */
+#define TRACE_BUFFER_SIZE (1 << 20)
+#define TRACE_BUFFER_ALIGN 4096
+
+/* referencias que play_trace() lee por bloque */
+#define TRACE_BLOCK 4096
+
+/* access types reported for lines that can not be parsed: no
+ * decimal type, or a missing address or one wider than 64 bits */
+#define TRACE_MALFORMED ((unsigned)-1)
+#define TRACE_BAD_ADDRESS ((unsigned)-2)
+
+/* formato binario de trazas
+ * Encabezado de 16 bytes:
+ *   0  magic "SIMB"
+ *   4  versión (uint32 little endian, TRACE_BINARY_VERSION)
+ *   8  número de registros (uint64 little endian)
+ * Cada registro es un entero LEB128 (7 bits por byte, el bit
+ * alto indica que sigue otro byte) con el valor
+ *   (zigzag(addr - prev[type]) << 2) | type
+ * donde type es 0, 1 o 2 como en main.h y prev[type] es la
+ * dirección del registro anterior del mismo tipo (0 al inicio).
+ * zigzag(d) = (d << 1) ^ (d >> 63) deja las diferencias pequeñas,
+ * positivas o negativas, en uno o dos bytes; el valor completo
+ * puede tener hasta 66 bits (10 bytes).
+ * La versión 1 tenía direcciones de 32 bits: la diferencia y su
+ * zigzag son de 32 bits y la suma da la vuelta en 2^32. Se sigue
+ * leyendo, pero convert_trace() solo escribe la versión 2. */
+#define TRACE_BINARY_MAGIC "SIMB"
+#define TRACE_BINARY_VERSION 2
+#define TRACE_BINARY_HEADER_SIZE 16
+
+/* bytes del inicio de la traza que identifican su compresión */
+#define TRACE_MAGIC_SIZE 6
+
+/* structure definitions */
+// lector de archivos *.trace. Si el archivo se puede mapear
+// a memoria, data apunta directamente al mapeo y no se copia
+// nada; si no (pipes), data apunta a un buffer alineado que se
+// rellena por bloques de TRACE_BUFFER_SIZE bytes. En ambos
+// casos [pos, size) es la porción de data aún sin leer.
+// Una traza comprimida se lee de la salida de un proceso que la
+// descomprime (child) y una que no se mapea se decodifica en un
+// hilo aparte (pipeline, ver ring.c).
+typedef struct trace_reader_
+{
+  int fd;            /* file descriptor of the trace */
+  int source_fd;     /* compressed input when fd is a decompressor, else -1 */
+  int child;         /* pid of the decompressor, 0 if none */
+  const char *tool;  /* name of the decompressor */
+  struct trace_feeder_ *feeder; /* copies stdin into the decompressor */
+  struct trace_pipeline_ *pipeline; /* reader threads, NULL if parsed here */
+  const char *data;  /* mapped file or read buffer */
+  size_t size;       /* number of valid bytes in data */
+  size_t pos;        /* next byte to parse */
+  int mapped;        /* TRUE if data is a memory map of the file */
+  char *buffer;      /* read buffer when the file is not mapped */
+  int eof;           /* TRUE once the last block has been read */
+  int binary;        /* version of the binary format, 0 for text */
+  unsigned long long records;   /* binary records in the header, 0 in parser views */
+  unsigned long long remaining; /* binary records still to decode */
+  int failed;        /* TRUE if the trace turned out to be incomplete */
+  sim_addr prev_addr[4]; /* last address seen for each type, 3 is invalid */
+#if defined(SIM_PROFILE)
+  unsigned long long read_ticks; /* time spent in read_trace_block() */
+  long long read_records;        /* references it returned */
+#endif
+} trace_reader, *Ptrace_reader;
+
+/* function prototypes */
+Ptrace_reader open_trace();
+int read_trace_record();
+int read_trace_element();
+int read_trace_block();
+void print_skipped_access();
+void pipeline_trace();
+void print_trace_pipeline();
+long long trace_offset();
+int seek_trace();
+int end_binary_trace();
+int close_trace();
+long long convert_trace();
@@ -0,0 +1,192 @@
+/*
+ * victim.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "cache.h"
+#include "hierarchy.h"
+#include "victim.h"
+
+/************************************************************/
+// victim caches de L1 (Jouppi). Cada L1 tiene uno, totalmente
+// asociativo y LRU, que recibe todas las líneas que L1 reemplaza
+// (el hardware no distingue los conflictos, pero son los que
+// regresan). Un fallo de L1 que encuentra su bloque aquí no lo
+// pide abajo: el bloque sube a L1 y la línea que L1 reemplace
+// ocupa su lugar. Las líneas sucias se escriben al salir del
+// victim cache, no al salir de L1.
+/************************************************************/
+
+/************************************************************/
+/* gives an L1 cache its victim cache, or none */
+void init_victim(Pcache ptr_cache, int entries)
+{
+  Pvictim_cache vc;
+
+  ptr_cache->victim = NULL;
+  if (entries <= 0) {
+    return;
+  }
+  vc = (Pvictim_cache)calloc(1, sizeof(victim_cache));
+  vc->entries = entries;
+  vc->blocks = (sim_addr *)malloc(sizeof(sim_addr) * entries);
+  vc->dirty = (unsigned char *)malloc(entries);
+  vc->stamp = (unsigned long long *)malloc(sizeof(unsigned long long) * entries);
+  ptr_cache->victim = vc;
+}
+
+void free_victim(Pvictim_cache vc)
+{
+  if (vc) {
+    free(vc->blocks);
+    free(vc->dirty);
+    free(vc->stamp);
+    free(vc);
+  }
+}
+
+/* helper function to find a block, -1 if absent */
+static int victim_find(Pvictim_cache vc, sim_addr block)
+{
+  for (int i = 0; i < vc->count; i++) {
+    if (vc->blocks[i] == block) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* helper function to take out entry i; the last one fills the hole.
+ * Returns its dirty bit */
+static int victim_remove(Pvictim_cache vc, int i)
+{
+  int dirty = vc->dirty[i];
+
+  vc->count--;
+  vc->blocks[i] = vc->blocks[vc->count];
+  vc->dirty[i] = vc->dirty[vc->count];
+  vc->stamp[i] = vc->stamp[vc->count];
+  return dirty;
+}
+/************************************************************/
+
+/************************************************************/
+// un fallo de L1 que va a traer el bloque (index, tag): si está en
+// el victim cache lo saca de ahí y regresa su dirty bit; si no,
+// regresa -1 y el bloque se tiene que pedir abajo
+int victim_probe(Pcache_sim sim, Pcache ptr_cache, int index, sim_addr tag)
+{
+  Pvictim_cache vc = ptr_cache->victim;
+  int i = victim_find(vc, block_address(ptr_cache, index, tag) >> ptr_cache->index_mask_offset);
+
+  if (i < 0) {
+    return -1;
+  }
+  sim->victim_stats.hits++;
+  return victim_remove(vc, i);
+}
+
+// saca del victim cache de ptr_cache el bloque de addr, si está
+// (back invalidation de una jerarquía inclusiva); regresa TRUE si
+// estaba sucio
+int victim_invalidate(Pcache ptr_cache, sim_addr addr)
+{
+  Pvictim_cache vc = ptr_cache->victim;
+  int i;
+
+  if (!vc || (i = victim_find(vc, addr >> ptr_cache->index_mask_offset)) < 0) {
+    return FALSE;
+  }
+  return victim_remove(vc, i);
+}
+
+// TRUE si el bloque (número de bloque) está en el victim cache de
+// ptr_cache; el prefetcher no trae lo que ya está ahí
+int victim_contains(Pcache ptr_cache, sim_addr block)
+{
+  return ptr_cache->victim && victim_find(ptr_cache->victim, block) >= 0;
+}
+
+// la línea que ptr_cache acaba de reemplazar en el set index (ver
+// full_insert()) entra al victim cache. Quien llama ya contó el
+// reemplazo; response se modifica para que no se escriba la línea
+// reemplazada, que ahora vive aquí. Si el victim cache está lleno
+// sale su entrada LRU, que baja como cualquier línea reemplazada
+void victim_insert(Pcache_sim sim, Pcache ptr_cache, int index, Pinsertion_response response)
+{
+  Pvictim_cache vc = ptr_cache->victim;
+  int i;
+
+  if (!vc || !response->replacement) {
+    return;
+  }
+  if (vc->count < vc->entries) {
+    i = vc->count++;
+  } else {
+    i = 0;
+    for (int j = 1; j < vc->count; j++) {
+      if (vc->stamp[j] < vc->stamp[i]) {
+        i = j;
+      }
+    }
+    COUNT_COPY_BACK(&sim->cache_stat_data, vc->dirty[i] * sim->words_per_block);
+    if (sim->n_lower) {
+      hierarchy_evict(sim, vc->blocks[i] << ptr_cache->index_mask_offset, vc->dirty[i]);
+    }
+  }
+  vc->blocks[i] = block_address(ptr_cache, index, response->victim_tag) >> ptr_cache->index_mask_offset;
+  vc->dirty[i] = response->dirty_bit;
+  vc->stamp[i] = ++vc->clock;
+  sim->victim_stats.inserts++;
+
+  response->replacement = FALSE;
+  response->dirty_bit = 0;
+}
+
+// vacía el victim cache de ptr_cache en flush(); las entradas
+// sucias se cuentan como las líneas sucias de free_structure()
+void victim_flush(Pcache_sim sim, Pcache ptr_cache)
+{
+  Pvictim_cache vc = ptr_cache->victim;
+
+  if (!vc) {
+    return;
+  }
+  for (int i = 0; i < vc->count; i++) {
+    COUNT_COPY_BACK(&sim->cache_stat_inst, vc->dirty[i] * sim->words_per_block);
+    if (vc->dirty[i] && sim->n_lower) {
+      lower_writeback(sim, 0, vc->blocks[i] << ptr_cache->index_mask_offset);
+    }
+  }
+  vc->count = 0;
+}
+/************************************************************/
+
+/************************************************************/
+// imprime el tamaño del victim cache, como dump_settings()
+void dump_victim_settings(Pcache_sim sim)
+{
+  if (sim->victim_entries > 0) {
+    printf("  Victim cache: \t\t%d blocks\n", sim->victim_entries);
+  }
+}
+
+// imprime las estadísticas de los victim caches, como
+// print_stats(). En modo CSV agrega su tamaño, hits e inserciones
+void print_victim_stats(Pcache_sim sim)
+{
+  if (sim->victim_entries <= 0) {
+    return;
+  }
+  if (sim->debug) {
+    printf(" VICTIM CACHE (%d blocks)\n", sim->victim_entries);
+    printf("  hits:      %lld\n", sim->victim_stats.hits);
+    printf("  inserts:   %lld\n", sim->victim_stats.inserts);
+    printf("\n");
+  } else {
+    printf(",%d,%lld,%lld", sim->victim_entries, sim->victim_stats.hits, sim->victim_stats.inserts);
+  }
+}
+/************************************************************/
@@ -0,0 +1,13 @@
+/*
+ * victim.h
+ */
+
+void init_victim();
+void free_victim();
+int victim_probe();
+int victim_invalidate();
+int victim_contains();
+void victim_insert();
+void victim_flush();
+void dump_victim_settings();
+void print_victim_stats();
@@ -0,0 +1,197 @@
+/*
+ * writebuf.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "cache.h"
+#include "hierarchy.h"
+#include "writebuf.h"
+
+/************************************************************/
+// buffer de escritura de los caches write through. Sin él cada
+// escritura que pasa de L1 cuenta una palabra de copies back, como
+// si la memoria recibiera las escrituras una por una. Con él las
+// escrituras entran a una cola FIFO de bloques: una escritura a un
+// bloque que ya está en la cola se combina con esa entrada, y la
+// memoria escribe una entrada (sus palabras distintas) cada
+// wbuf_rate referencias. Con WBUF_DRAIN_EAGER la memoria escribe
+// mientras haya algo en la cola; con WBUF_DRAIN_FULL solo cuando
+// se llena, lo que combina más y detiene más. Una escritura que
+// encuentra la cola llena espera (stall) a que salga la más
+// antigua. Las lecturas no consultan la cola: no cambian el tráfico.
+// El tiempo es el número de referencias, como en el prefetcher.
+/************************************************************/
+
+static const char *drain_names[WBUF_DRAINS] = { "eager", "full" };
+
+const char *drain_name(int policy)
+{
+  return drain_names[policy];
+}
+
+int drain_from_name(const char *name)
+{
+  for (int policy = 0; policy < WBUF_DRAINS; policy++) {
+    if (!strcmp(name, drain_names[policy])) {
+      return policy;
+    }
+  }
+  return -1;
+}
+
+/************************************************************/
+/* gives sim its write buffer, or none; a write-back cache has no
+ * stores to buffer, so it never gets one */
+void init_write_buffer(Pcache_sim sim)
+{
+  Pwrite_buffer wb;
+
+  sim->wbuf = NULL;
+  if (sim->wbuf_entries <= 0 || sim->cache_writeback) {
+    return;
+  }
+  wb = (Pwrite_buffer)calloc(1, sizeof(write_buffer));
+  wb->mask_words = (sim->words_per_block + 63) / 64;
+  wb->blocks = (sim_addr *)malloc(sizeof(sim_addr) * sim->wbuf_entries);
+  wb->masks = (unsigned long long *)malloc(sizeof(unsigned long long) * sim->wbuf_entries * wb->mask_words);
+  sim->wbuf = wb;
+}
+
+void free_write_buffer(Pwrite_buffer wb)
+{
+  if (wb) {
+    free(wb->blocks);
+    free(wb->masks);
+    free(wb);
+  }
+}
+
+/* helper function with the current time, in references */
+static long long write_buffer_now(Pcache_sim sim)
+{
+  return sim->clock_base + sim->cache_stat_inst.accesses + sim->cache_stat_data.accesses;
+}
+
+/* helper function to write the oldest entry downstream: its
+ * distinct words to memory, or the block to L2 */
+static void write_buffer_retire(Pcache_sim sim, Pwrite_buffer wb)
+{
+  unsigned long long *mask = wb->masks;
+  int words = 0;
+
+  for (int i = 0; i < wb->mask_words; i++) {
+    words += __builtin_popcountll(mask[i]);
+  }
+  COUNT_COPY_BACK(&sim->cache_stat_data, words);
+  sim->wbuf_stats.drains++;
+  sim->wbuf_stats.words += words;
+  if (sim->n_lower) {
+    hierarchy_write(sim, wb->blocks[0] << sim->ptr_dcache->index_mask_offset);
+  }
+  wb->count--;
+  memmove(wb->blocks, wb->blocks + 1, sizeof(sim_addr) * wb->count);
+  memmove(wb->masks, wb->masks + wb->mask_words, sizeof(unsigned long long) * wb->count * wb->mask_words);
+}
+
+/* helper function to retire the entries memory had time to write
+ * since the last store; it only writes while the buffer holds more
+ * than keep entries, and is idle otherwise */
+static void write_buffer_advance(Pcache_sim sim, Pwrite_buffer wb)
+{
+  long long now = write_buffer_now(sim);
+  int keep = sim->wbuf_drain == WBUF_DRAIN_FULL ? sim->wbuf_entries - 1 : 0;
+
+  while (wb->count > keep && now - wb->busy_since >= sim->wbuf_rate) {
+    write_buffer_retire(sim, wb);
+    wb->busy_since += sim->wbuf_rate;
+  }
+  if (wb->count <= keep) {
+    wb->busy_since = now;
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// una escritura write through a la palabra de addr: en lugar de
+// contar una palabra de copies back, entra al buffer
+void write_buffer_store(Pcache_sim sim, sim_addr addr)
+{
+  Pwrite_buffer wb = sim->wbuf;
+  sim_addr block = addr >> sim->ptr_dcache->index_mask_offset;
+  int word = (int)(addr >> WORD_SIZE_OFFSET) & (sim->words_per_block - 1);
+  unsigned long long *mask;
+  int i;
+
+  write_buffer_advance(sim, wb);
+  sim->wbuf_stats.stores++;
+  for (i = 0; i < wb->count; i++) {
+    if (wb->blocks[i] == block) {
+      wb->masks[i * wb->mask_words + word / 64] |= 1ull << (word % 64);
+      sim->wbuf_stats.merged++;
+      return;
+    }
+  }
+  if (wb->count == sim->wbuf_entries) {
+    // el procesador espera a que la memoria termine la más antigua
+    sim->wbuf_stats.stalls++;
+    write_buffer_retire(sim, wb);
+    wb->busy_since = write_buffer_now(sim);
+  }
+  i = wb->count++;
+  wb->blocks[i] = block;
+  mask = &wb->masks[i * wb->mask_words];
+  memset(mask, 0, sizeof(unsigned long long) * wb->mask_words);
+  mask[word / 64] = 1ull << (word % 64);
+}
+
+// vacía el buffer en flush(), antes que los niveles de abajo
+void write_buffer_flush(Pcache_sim sim)
+{
+  Pwrite_buffer wb = sim->wbuf;
+
+  if (!wb) {
+    return;
+  }
+  while (wb->count > 0) {
+    write_buffer_retire(sim, wb);
+  }
+}
+/************************************************************/
+
+/************************************************************/
+// imprime la configuración del buffer, como dump_settings()
+void dump_write_buffer_settings(Pcache_sim sim)
+{
+  if (sim->wbuf) {
+    printf("  Write buffer: \t%d entries (%s, %d references per entry)\n", sim->wbuf_entries,
+           drain_name(sim->wbuf_drain), sim->wbuf_rate);
+  }
+}
+
+// imprime las estadísticas del buffer, como print_stats(). En
+// modo CSV agrega sus entradas, su política de vaciado, escrituras,
+// combinadas, stalls, entradas escritas y palabras escritas
+void print_write_buffer_stats(Pcache_sim sim)
+{
+  Pwrite_buffer_stat stat = &sim->wbuf_stats;
+
+  if (!sim->wbuf) {
+    return;
+  }
+  if (sim->debug) {
+    printf(" WRITE BUFFER (%d entries, %s)\n", sim->wbuf_entries, drain_name(sim->wbuf_drain));
+    printf("  stores:    %lld\n", stat->stores);
+    printf("  merged:    %lld\n", stat->merged);
+    printf("  stalls:    %lld\n", stat->stalls);
+    printf("  drains:    %lld\n", stat->drains);
+    printf("  words:     %lld\n", stat->words);
+    printf("\n");
+  } else {
+    printf(",%d,%s,%lld,%lld,%lld,%lld,%lld", sim->wbuf_entries, drain_name(sim->wbuf_drain),
+           stat->stores, stat->merged, stat->stalls, stat->drains, stat->words);
+  }
+}
+/************************************************************/
@@ -0,0 +1,10 @@
+/*
+ * writebuf.h
+ */
+
+void init_write_buffer();
+void free_write_buffer();
+void write_buffer_store();
+void write_buffer_flush();
+void dump_write_buffer_settings();
+void print_write_buffer_stats();